@@ -0,0 +1,425 @@
+#include <fstream>
+#include <sstream>
+#include "mmcomp"
+#include "riskmgmt"
+#include "ordtyp.cpp"
+
+// Microbenchmarks
+//   bench [--filter substr] [--samples N] [--format table|csv|json]
+//         [--baseline file.csv] [--tolerance 0.10]
+// Samples are timed with LatencyClock (TSC on x86): each sample runs a batch of operations and
+// records the mean per operation, so clock overhead is amortized while the distribution still
+// shows stalls. With --baseline, the run fails if any benchmark's p50 regressed by more than the
+// tolerance against a previous --format csv run.
+
+namespace {
+
+template<typename T>
+inline void do_not_optimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct BenchResult {
+    std::string name;
+    size_t samples;
+    size_t batch;
+    double mean_ns;
+    double p50_ns;
+    double p90_ns;
+    double p99_ns;
+    double p999_ns;
+    double max_ns;
+};
+
+class BenchRunner {
+private:
+    std::string filter_;
+    size_t samples_;
+    std::vector<BenchResult> results_;
+
+    void record(const std::string& name, size_t batch, std::vector<double>& per_op) {
+        std::sort(per_op.begin(), per_op.end());
+        auto at = [&per_op](double q) {
+            return per_op[std::min(per_op.size() - 1, static_cast<size_t>(q * static_cast<double>(per_op.size())))];
+        };
+        double sum = 0.0;
+        for (double v : per_op) {
+            sum += v;
+        }
+        results_.push_back(BenchResult{name, per_op.size(), batch, sum / static_cast<double>(per_op.size()),
+                                       at(0.50), at(0.90), at(0.99), at(0.999), per_op.back()});
+    }
+
+public:
+    BenchRunner(std::string filter, size_t samples) : filter_(std::move(filter)), samples_(samples) {}
+
+    bool selected(const std::string& name) const {
+        return filter_.empty() || name.find(filter_) != std::string::npos;
+    }
+
+    // Times batch calls of op per sample, after a warm-up of a tenth of the samples
+    template<typename Op>
+    void run(const std::string& name, size_t batch, Op&& op) {
+        if (!selected(name)) {
+            return;
+        }
+        for (size_t s = 0; s < samples_ / 10; ++s) {
+            for (size_t i = 0; i < batch; ++i) {
+                op();
+            }
+        }
+        std::vector<double> per_op(samples_);
+        for (size_t s = 0; s < samples_; ++s) {
+            int64_t start = LatencyClock::now_ns();
+            for (size_t i = 0; i < batch; ++i) {
+                op();
+            }
+            per_op[s] = static_cast<double>(LatencyClock::now_ns() - start) / static_cast<double>(batch);
+        }
+        record(name, batch, per_op);
+    }
+
+    // For benchmarks that time themselves: sample() returns nanoseconds for one operation
+    template<typename Sample>
+    void run_sampled(const std::string& name, size_t samples, Sample&& sample) {
+        if (!selected(name)) {
+            return;
+        }
+        std::vector<double> per_op(samples);
+        for (size_t s = 0; s < samples; ++s) {
+            per_op[s] = sample();
+        }
+        record(name, 1, per_op);
+    }
+
+    const std::vector<BenchResult>& results() const { return results_; }
+};
+
+void print_table(const std::vector<BenchResult>& results) {
+    std::printf("%-32s %10s %10s %10s %10s %10s %12s\n", "benchmark", "mean_ns", "p50_ns", "p90_ns", "p99_ns",
+                "p99.9_ns", "max_ns");
+    for (const auto& r : results) {
+        std::printf("%-32s %10.1f %10.1f %10.1f %10.1f %10.1f %12.1f\n", r.name.c_str(), r.mean_ns, r.p50_ns,
+                    r.p90_ns, r.p99_ns, r.p999_ns, r.max_ns);
+    }
+}
+
+void print_csv(const std::vector<BenchResult>& results) {
+    std::printf("name,samples,batch,mean_ns,p50_ns,p90_ns,p99_ns,p999_ns,max_ns\n");
+    for (const auto& r : results) {
+        std::printf("%s,%zu,%zu,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f\n", r.name.c_str(), r.samples, r.batch, r.mean_ns,
+                    r.p50_ns, r.p90_ns, r.p99_ns, r.p999_ns, r.max_ns);
+    }
+}
+
+void print_json(const std::vector<BenchResult>& results) {
+    std::printf("[\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        std::printf("  {\"name\": \"%s\", \"samples\": %zu, \"batch\": %zu, \"mean_ns\": %.2f, \"p50_ns\": %.2f, "
+                    "\"p90_ns\": %.2f, \"p99_ns\": %.2f, \"p999_ns\": %.2f, \"max_ns\": %.2f}%s\n",
+                    r.name.c_str(), r.samples, r.batch, r.mean_ns, r.p50_ns, r.p90_ns, r.p99_ns, r.p999_ns,
+                    r.max_ns, i + 1 < results.size() ? "," : "");
+    }
+    std::printf("]\n");
+}
+
+// Compares p50 against a CSV baseline; returns the number of regressions
+size_t compare_baseline(const std::vector<BenchResult>& results, const std::string& path, double tolerance) {
+    std::ifstream in(path);
+    if (!in) {
+        throw std::runtime_error("Cannot read baseline " + path);
+    }
+    std::unordered_map<std::string, double> baseline;
+    std::string line;
+    std::getline(in, line);  // Header
+    while (std::getline(in, line)) {
+        std::stringstream fields(line);
+        std::string name, samples, batch, mean, p50;
+        if (std::getline(fields, name, ',') && std::getline(fields, samples, ',') &&
+            std::getline(fields, batch, ',') && std::getline(fields, mean, ',') && std::getline(fields, p50, ',')) {
+            baseline[name] = std::stod(p50);
+        }
+    }
+    size_t regressions = 0;
+    for (const auto& r : results) {
+        auto it = baseline.find(r.name);
+        if (it != baseline.end() && r.p50_ns > it->second * (1.0 + tolerance)) {
+            std::fprintf(stderr, "REGRESSION %s: p50 %.1fns vs baseline %.1fns (+%.0f%%)\n", r.name.c_str(),
+                         r.p50_ns, it->second, 100.0 * (r.p50_ns / it->second - 1.0));
+            ++regressions;
+        }
+    }
+    return regressions;
+}
+
+// Benchmarks
+
+void bench_queues(BenchRunner& runner) {
+    auto spsc = std::make_unique<LockFreeQueue<uint64_t, 1024>>();
+    runner.run("spsc_push_pop", 256, [&spsc]() {
+        uint64_t v = 0;
+        if (!spsc->push(1) || !spsc->pop(v)) {
+            throw std::logic_error("spsc_push_pop: round trip through an empty queue failed");  // Not timed as work
+        }
+        do_not_optimize(v);
+    });
+
+    auto mpmc = std::make_unique<MpmcQueue<uint64_t, 1024>>();
+    runner.run("mpmc_push_pop", 256, [&mpmc]() {
+        uint64_t v = 0;
+        if (!mpmc->push(1) || !mpmc->pop(v)) {
+            throw std::logic_error("mpmc_push_pop: round trip through an empty queue failed");  // Not timed as work
+        }
+        do_not_optimize(v);
+    });
+
+    // Round trip through two SPSC rings to a thread on another core
+    if (!runner.selected("spsc_pingpong_rtt")) {
+        return;
+    }
+    auto ping = std::make_unique<LockFreeQueue<uint64_t, 1024>>();
+    auto pong = std::make_unique<LockFreeQueue<uint64_t, 1024>>();
+    bool single_core = std::thread::hardware_concurrency() < 2;
+    std::atomic<bool> running{true};
+    std::thread echo([&]() {
+        pin_current_thread(single_core ? -1 : 1, "bench-echo");
+        uint64_t v = 0;
+        while (running.load(std::memory_order_relaxed)) {
+            if (ping->pop(v)) {
+                while (!pong->push(v)) {
+                    cpu_relax();
+                }
+            } else if (single_core) {
+                std::this_thread::yield();
+            } else {
+                cpu_relax();
+            }
+        }
+    });
+    pin_current_thread(single_core ? -1 : 0);
+    uint64_t sequence = 0;
+    runner.run_sampled("spsc_pingpong_rtt", single_core ? 2000 : 100000, [&]() {
+        int64_t start = LatencyClock::now_ns();
+        (void)ping->push(++sequence);
+        uint64_t v = 0;
+        while (!pong->pop(v)) {
+            if (single_core) {
+                std::this_thread::yield();
+            } else {
+                cpu_relax();
+            }
+        }
+        return static_cast<double>(LatencyClock::now_ns() - start);
+    });
+    running = false;
+    echo.join();
+}
+
+void bench_allocator(BenchRunner& runner) {
+    LockFreeAllocator<Order> pool(4096);
+    runner.run("allocator_alloc_free", 256, [&pool]() {
+        Order* order = pool.allocate();
+        do_not_optimize(order);
+        pool.deallocate(order);
+    });
+}
+
+void bench_book(BenchRunner& runner, SymbolId symbol) {
+    OrderBook book(symbol, 4096, 65536, 10000);
+    std::vector<Quote> quotes(4096);
+    std::mt19937_64 rng(1);
+    Price mid = 10000;
+    for (auto& quote : quotes) {
+        mid += static_cast<Price>(rng() % 3) - 1;
+        quote.symbol = symbol;
+        quote.bid = mid - 1 - static_cast<Price>(rng() % 2);
+        quote.ask = mid + 1 + static_cast<Price>(rng() % 2);
+        quote.bid_size = 100 * (1 + rng() % 10);
+        quote.ask_size = 100 * (1 + rng() % 10);
+    }
+    size_t i = 0;
+    runner.run("book_update", 256, [&]() {
+        do_not_optimize(book.update(quotes[i++ & 4095]));
+    });
+    runner.run("book_get_top_of_book", 256, [&book]() {
+        Quote quote = book.get_top_of_book();
+        do_not_optimize(quote);
+    });
+}
+
+void bench_risk(BenchRunner& runner, SymbolId symbol) {
+    Order order;
+    order.order_id = 1;
+    order.symbol = symbol;
+    order.price = 10000;
+    order.quantity = 100;
+    order.is_buy = true;
+
+    RiskManager basic;
+    basic.set_position_limit(symbol, 1e9, 1e12);
+    runner.run("risk_check_basic", 256, [&]() {
+        do_not_optimize(basic.check_order(order));
+        basic.release(order, order.quantity);
+    });
+
+    AdvancedRiskManager advanced;
+    AdvancedRiskManager::RiskLimits limits{};
+    limits.max_gross_position = limits.max_net_position = 1e9;
+    limits.max_dollar_exposure = limits.var_limit = limits.es_limit = 1e12;
+    limits.max_order_size = 1e6;
+    advanced.set_risk_limits(symbol, limits);
+    runner.run("risk_check_advanced", 256, [&]() {
+        do_not_optimize(advanced.check_order(order));
+        advanced.release(order, order.quantity);
+    });
+}
+
+void bench_maker(BenchRunner& runner) {
+    if (!runner.selected("maker_update_quotes")) {
+        return;
+    }
+    MarketDataHandler market_data;
+    RiskManager risk_manager;
+    OrderManager order_manager(risk_manager);
+    MarketMaker maker(market_data, order_manager, risk_manager);
+    std::vector<std::pair<size_t, SymbolId>> configs;
+    for (size_t levels : {1, 4, 16}) {
+        SymbolId id = symbols().add("BENCHMM" + std::to_string(levels), 0.01);
+        risk_manager.set_position_limit(id, 1e12, 1e15);
+        maker.configure_symbol(id, 0.001, 100, 0.1, 0.01, levels, 0.5);
+        configs.emplace_back(levels, id);
+    }
+    order_manager.start();
+    RcuDomain::quiescent();  // Quote from this thread as a shard would: already an RCU reader
+    for (auto [levels, id] : configs) {
+        // Alternating mids, so every update amends the ladder
+        Quote quotes[2];
+        for (int q = 0; q < 2; ++q) {
+            quotes[q].symbol = id;
+            quotes[q].bid = 10000 + q * 5;
+            quotes[q].ask = 10002 + q * 5;
+            quotes[q].bid_size = quotes[q].ask_size = 500;
+        }
+        size_t i = 0;
+        runner.run("maker_update_quotes_L" + std::to_string(levels), 1, [&]() {
+            maker.update_quotes(id, quotes[i++ & 1]);
+        });
+    }
+    order_manager.stop();
+    RcuDomain::offline();
+}
+
+// TriggerEngine::on_quote against a book of resting conditional orders on both sides
+void bench_triggers(BenchRunner& runner, SymbolId symbol) {
+    static constexpr size_t RESTING = 65536;
+    auto engine = std::make_unique<TriggerEngine>(RESTING + 64);
+    uint64_t next_id = 1;
+    auto base = [&](auto& order, bool is_buy) {
+        order.order_id = next_id++;
+        order.symbol = symbol;
+        order.is_buy = is_buy;
+        order.quantity = 100;
+    };
+    for (size_t i = 0; i < RESTING / 8; ++i) {
+        Price offset = static_cast<Price>(i % 512);
+        for (bool is_buy : {true, false}) {
+            StopOrder stop{};
+            base(stop, is_buy);
+            stop.stop_price = is_buy ? 10100 + offset : 9900 - offset;
+            (void)engine->add(stop);
+            StopLimitOrder stop_limit{};
+            base(stop_limit, is_buy);
+            stop_limit.stop_price = is_buy ? 10100 + offset : 9900 - offset;
+            stop_limit.limit_price = is_buy ? stop_limit.stop_price + 10 : stop_limit.stop_price - 10;
+            (void)engine->add(stop_limit);
+            LimitOrder limit{};
+            base(limit, is_buy);
+            limit.limit_price = is_buy ? 9900 - offset : 10100 + offset;
+            (void)engine->add(limit);
+            TrailingStopOrder trailing{};
+            base(trailing, is_buy);
+            trailing.trail_distance = 500;
+            (void)engine->add(trailing);
+        }
+    }
+
+    size_t fired = 0;
+    auto emit = [&fired](const Order&) { ++fired; };
+    Quote quote;
+    quote.symbol = symbol;
+    size_t i = 0;
+    // The market moves inside the resting orders' range: nothing crosses, nothing is examined
+    runner.run("trigger_engine_quote_resting", 256, [&]() {
+        Price drift = static_cast<Price>(i++ & 7);
+        quote.bid = 9998 + drift;
+        quote.ask = 10002 + drift;
+        engine->on_quote(quote, emit);
+    });
+
+    // One new stop per quote, crossed by it at once: add, pop and emit with the book still resting
+    quote.bid = 9998;
+    quote.ask = 10002;
+    runner.run("trigger_engine_add_and_fire", 256, [&]() {
+        StopOrder stop{};
+        base(stop, true);
+        stop.stop_price = 10002;
+        (void)engine->add(stop);
+        engine->on_quote(quote, emit);
+    });
+    do_not_optimize(fired);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    try {
+        std::string filter;
+        std::string format = "table";
+        std::string baseline;
+        double tolerance = 0.10;
+        size_t samples = 20000;
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--filter" && i + 1 < argc) {
+                filter = argv[++i];
+            } else if (arg == "--samples" && i + 1 < argc) {
+                samples = std::max<size_t>(10, std::strtoul(argv[++i], nullptr, 10));
+            } else if (arg == "--format" && i + 1 < argc) {
+                format = argv[++i];
+            } else if (arg == "--baseline" && i + 1 < argc) {
+                baseline = argv[++i];
+            } else if (arg == "--tolerance" && i + 1 < argc) {
+                tolerance = std::atof(argv[++i]);
+            } else {
+                std::cerr << "usage: bench [--filter substr] [--samples N] [--format table|csv|json] "
+                             "[--baseline file.csv] [--tolerance 0.10]" << std::endl;
+                return 2;
+            }
+        }
+
+        SymbolId symbol = symbols().add("BENCH", 0.01);
+        BenchRunner runner(filter, samples);
+        bench_queues(runner);
+        bench_allocator(runner);
+        bench_book(runner, symbol);
+        bench_risk(runner, symbol);
+        bench_maker(runner);
+        bench_triggers(runner, symbol);
+
+        if (format == "csv") {
+            print_csv(runner.results());
+        } else if (format == "json") {
+            print_json(runner.results());
+        } else {
+            print_table(runner.results());
+        }
+        if (!baseline.empty() && compare_baseline(runner.results(), baseline, tolerance) > 0) {
+            return 1;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,28 @@
+#include "common.hpp"
+
+// Process-wide singletons, defined once here rather than inline in every including component
+
+SymbolRegistry& SymbolRegistry::instance() {
+    static SymbolRegistry registry;
+    return registry;
+}
+
+LatencyRegistry& LatencyRegistry::instance() {
+    static LatencyRegistry registry;
+    return registry;
+}
+
+MetricsRegistry& MetricsRegistry::instance() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+AsyncLogger& AsyncLogger::instance() {
+    static AsyncLogger logger;
+    return logger;
+}
+
+RcuDomain& RcuDomain::instance() {
+    static RcuDomain domain;
+    return domain;
+}
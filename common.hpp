@@ -0,0 +1,3989 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <bit>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Forward declarations
+class OrderBook;
+class MarketDataHandler;
+class RiskManager;
+
+// Dense symbol ids are assigned at startup; prices travel as integer ticks of the symbol's tick size
+using SymbolId = uint32_t;
+using Price = int64_t;
+
+constexpr SymbolId INVALID_SYMBOL = ~SymbolId{0};
+constexpr size_t MAX_SYMBOLS = 4096;
+
+// Market data structures
+struct Quote {
+    SymbolId symbol = INVALID_SYMBOL;
+    Price bid = 0;
+    Price ask = 0;
+    size_t bid_size = 0;
+    size_t ask_size = 0;
+    std::chrono::nanoseconds timestamp{0};
+};
+
+struct Trade {
+    SymbolId symbol = INVALID_SYMBOL;
+    Price price = 0;
+    size_t quantity = 0;
+    bool is_buy = false;
+    std::chrono::nanoseconds timestamp{0};
+};
+
+// Order structures
+enum class OrderStatus : uint8_t {
+    New,
+    Filled,
+    Cancelled,
+    Rejected,
+};
+
+struct Order {
+    uint64_t order_id = 0;
+    SymbolId symbol = INVALID_SYMBOL;
+    Price price = 0;
+    size_t quantity = 0;
+    bool is_buy = false;
+    std::chrono::nanoseconds timestamp{0};
+    OrderStatus status = OrderStatus::New;
+};
+
+static_assert(std::is_trivially_copyable_v<Quote>, "Quote must be trivially copyable");
+static_assert(std::is_trivially_copyable_v<Trade>, "Trade must be trivially copyable");
+static_assert(std::is_trivially_copyable_v<Order>, "Order must be trivially copyable");
+
+// Low-overhead monotonic clock. On x86 it reads the TSC and scales it with a factor calibrated
+// against steady_clock at static-init time; elsewhere it falls back to steady_clock.
+class LatencyClock {
+private:
+#if defined(__x86_64__) || defined(__i386__)
+    struct Calibration {
+        uint64_t base_tsc;
+        int64_t base_ns;
+        double ns_per_tick;
+    };
+
+    static Calibration calibrate() {
+        using namespace std::chrono;
+        auto t0 = steady_clock::now();
+        uint64_t c0 = __rdtsc();
+        while (steady_clock::now() - t0 < milliseconds(10)) {}
+        auto t1 = steady_clock::now();
+        uint64_t c1 = __rdtsc();
+        double ns = static_cast<double>(duration_cast<nanoseconds>(t1 - t0).count());
+        return Calibration{c1, duration_cast<nanoseconds>(t1.time_since_epoch()).count(),
+                           ns / static_cast<double>(c1 - c0)};
+    }
+
+    inline static const Calibration calibration_ = calibrate();
+#endif
+
+public:
+    // Nanoseconds on the steady_clock time base
+    static int64_t now_ns() {
+#if defined(__x86_64__) || defined(__i386__)
+        return calibration_.base_ns + static_cast<int64_t>(
+            static_cast<double>(static_cast<int64_t>(__rdtsc() - calibration_.base_tsc)) *
+            calibration_.ns_per_tick);
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+};
+
+inline std::chrono::nanoseconds get_current_timestamp() {
+    return std::chrono::nanoseconds(LatencyClock::now_ns());
+}
+
+// Symbol registry
+// Tickers are interned to dense ids once at startup; everything downstream indexes by id.
+// Registration is not synchronised and must finish before trading threads start.
+class SymbolRegistry {
+private:
+    struct SymbolInfo {
+        std::string name;
+        double tick_size;
+    };
+
+    std::vector<SymbolInfo> symbols_;
+    std::unordered_map<std::string, SymbolId> ids_;
+
+public:
+    SymbolRegistry() {
+        symbols_.reserve(MAX_SYMBOLS);
+    }
+
+    // Defined in common.cpp, so every component linked into a process shares one registry
+    static SymbolRegistry& instance();
+
+    // Returns the existing id if the symbol is already registered
+    SymbolId add(const std::string& name, double tick_size) {
+        auto it = ids_.find(name);
+        if (it != ids_.end()) {
+            return it->second;
+        }
+        if (symbols_.size() >= MAX_SYMBOLS) {
+            throw std::length_error("Symbol registry full");
+        }
+        SymbolId id = static_cast<SymbolId>(symbols_.size());
+        symbols_.push_back(SymbolInfo{name, tick_size});
+        ids_.emplace(name, id);
+        return id;
+    }
+
+    // Control path only
+    SymbolId find(const std::string& name) const {
+        auto it = ids_.find(name);
+        return it == ids_.end() ? INVALID_SYMBOL : it->second;
+    }
+
+    size_t size() const { return symbols_.size(); }
+    const std::string& name(SymbolId id) const { return symbols_[id].name; }
+    double tick_size(SymbolId id) const { return symbols_[id].tick_size; }
+
+    double to_price(SymbolId id, Price ticks) const {
+        return static_cast<double>(ticks) * symbols_[id].tick_size;
+    }
+
+    Price to_ticks(SymbolId id, double price) const {
+        return std::llround(price / symbols_[id].tick_size);
+    }
+};
+
+inline SymbolRegistry& symbols() {
+    return SymbolRegistry::instance();
+}
+
+// Cache line size used to keep independently written state apart
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+// Lock-free single-producer/single-consumer ring for inter-thread communication.
+// Producer and consumer indices live on separate cache lines, and each side keeps a private copy
+// of the other side's index so the shared line is only touched when the ring looks full or empty.
+// Indices run free and are masked, so Capacity must be a power of two and every slot is usable.
+template<typename T, size_t Capacity = 1024>
+class LockFreeQueue {
+private:
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                  "LockFreeQueue capacity must be a power of two");
+    static constexpr size_t MASK = Capacity - 1;
+
+    struct alignas(T) Slot {
+        unsigned char bytes[sizeof(T)];
+    };
+
+    // Producer side
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail_{0};
+    size_t cached_head_ = 0;
+
+    // Consumer side
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> head_{0};
+    size_t cached_tail_ = 0;
+
+    alignas(CACHE_LINE_SIZE) Slot buffer_[Capacity];
+
+    T* slot(size_t index) {
+        return std::launder(reinterpret_cast<T*>(buffer_[index & MASK].bytes));
+    }
+
+    // Free slots visible to the producer, refreshing the cached head only when needed
+    size_t writable(size_t tail, size_t wanted) {
+        size_t free_slots = Capacity - (tail - cached_head_);
+        if (free_slots < wanted) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            free_slots = Capacity - (tail - cached_head_);
+        }
+        return free_slots;
+    }
+
+    // Filled slots visible to the consumer, refreshing the cached tail only when needed
+    size_t readable(size_t head, size_t wanted) {
+        size_t filled = cached_tail_ - head;
+        if (filled < wanted) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            filled = cached_tail_ - head;
+        }
+        return filled;
+    }
+
+public:
+    LockFreeQueue() = default;
+    LockFreeQueue(const LockFreeQueue&) = delete;
+    LockFreeQueue& operator=(const LockFreeQueue&) = delete;
+
+    ~LockFreeQueue() {
+        while (try_consume([](T&) {})) {}
+    }
+
+    static constexpr size_t capacity() { return Capacity; }
+
+    // Constructs the element directly in the ring; returns false if the ring is full
+    template<typename... Args>
+    [[nodiscard]] bool emplace(Args&&... args) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (writable(tail, 1) == 0) {
+            return false;
+        }
+        new (buffer_[tail & MASK].bytes) T(std::forward<Args>(args)...);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    [[nodiscard]] bool push(const T& item) { return emplace(item); }
+    [[nodiscard]] bool push(T&& item) { return emplace(std::move(item)); }
+
+    // Copies up to count items and publishes them with a single index store
+    size_t push_n(const T* items, size_t count) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t n = std::min(count, writable(tail, count));
+        for (size_t i = 0; i < n; ++i) {
+            new (buffer_[(tail + i) & MASK].bytes) T(items[i]);
+        }
+        if (n) {
+            tail_.store(tail + n, std::memory_order_release);
+        }
+        return n;
+    }
+
+    // Runs fn on the front element in place, then releases the slot
+    template<typename F>
+    bool try_consume(F&& fn) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (readable(head, 1) == 0) {
+            return false;
+        }
+        T* item = slot(head);
+        fn(*item);
+        item->~T();
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Runs fn on up to max_count elements in place, releasing them with a single index store
+    template<typename F>
+    size_t consume_n(F&& fn, size_t max_count) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t n = std::min(max_count, readable(head, max_count));
+        for (size_t i = 0; i < n; ++i) {
+            T* item = slot(head + i);
+            fn(*item);
+            item->~T();
+        }
+        if (n) {
+            head_.store(head + n, std::memory_order_release);
+        }
+        return n;
+    }
+
+    bool pop(T& item) {
+        return try_consume([&item](T& front) { item = std::move(front); });
+    }
+
+    size_t pop_n(T* items, size_t max_count) {
+        size_t i = 0;
+        return consume_n([items, &i](T& front) { items[i++] = std::move(front); }, max_count);
+    }
+
+    // Approximate when called concurrently with push/pop
+    size_t size() const {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+    bool empty() const { return size() == 0; }
+};
+
+// Bounded multi-producer/multi-consumer queue (Vyukov). Each cell carries a sequence stamp that
+// tells producers whether it is free and consumers whether it is filled. Producers only contend
+// on a CAS of the enqueue index, and a stalled producer never blocks the others.
+template<typename T, size_t Capacity = 1024>
+class MpmcQueue {
+private:
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                  "MpmcQueue capacity must be a power of two");
+    static constexpr size_t MASK = Capacity - 1;
+
+    struct alignas(CACHE_LINE_SIZE) Cell {
+        std::atomic<size_t> sequence;
+        alignas(T) unsigned char bytes[sizeof(T)];
+    };
+
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> enqueue_pos_{0};
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> dequeue_pos_{0};
+    alignas(CACHE_LINE_SIZE) Cell cells_[Capacity];
+
+public:
+    MpmcQueue() {
+        for (size_t i = 0; i < Capacity; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+    ~MpmcQueue() {
+        while (try_consume([](T&) {})) {}
+    }
+
+    static constexpr size_t capacity() { return Capacity; }
+
+    // Returns false without blocking if every cell is occupied
+    template<typename... Args>
+    [[nodiscard]] bool emplace(Args&&... args) {
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells_[pos & MASK];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;  // Queue is full
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        new (cell->bytes) T(std::forward<Args>(args)...);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    [[nodiscard]] bool push(const T& item) { return emplace(item); }
+    [[nodiscard]] bool push(T&& item) { return emplace(std::move(item)); }
+
+    // All or nothing: claims count consecutive cells with a single CAS, then fills them in order.
+    // Returns false without blocking if fewer than count cells are free.
+    [[nodiscard]] bool push_n(const T* items, size_t count) {
+        if (count == 0) {
+            return true;
+        }
+        if (count > Capacity) {
+            return false;
+        }
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        while (true) {
+            intptr_t diff = 0;
+            for (size_t i = 0; i < count && diff == 0; ++i) {
+                size_t seq = cells_[(pos + i) & MASK].sequence.load(std::memory_order_acquire);
+                diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + i);
+            }
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;  // Not enough room
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        for (size_t i = 0; i < count; ++i) {
+            Cell& cell = cells_[(pos + i) & MASK];
+            new (cell.bytes) T(items[i]);
+            cell.sequence.store(pos + i + 1, std::memory_order_release);
+        }
+        return true;
+    }
+
+    // Runs fn on the front element in place, then hands the cell back to producers
+    template<typename F>
+    bool try_consume(F&& fn) {
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells_[pos & MASK];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;  // Queue is empty
+            } else {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        T* item = std::launder(reinterpret_cast<T*>(cell->bytes));
+        fn(*item);
+        item->~T();
+        cell->sequence.store(pos + Capacity, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& item) {
+        return try_consume([&item](T& front) { item = std::move(front); });
+    }
+
+    // Approximate when called concurrently with push/pop
+    size_t size() const {
+        size_t head = dequeue_pos_.load(std::memory_order_acquire);
+        size_t tail = enqueue_pos_.load(std::memory_order_acquire);
+        return tail > head ? tail - head : 0;
+    }
+
+    bool empty() const { return size() == 0; }
+};
+
+// Custom memory allocator for low latency
+// Fixed-capacity object pool over one preallocated, pre-faulted slab. Free slots form a lock-free
+// stack whose head packs a 32-bit ABA tag with a 32-bit slot index, so any thread may allocate or
+// return slots. Exhaustion returns nullptr and is counted rather than thrown.
+template<typename T>
+class LockFreeAllocator {
+private:
+    static constexpr uint32_t NIL = ~uint32_t{0};
+    static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+    struct Slot {
+        alignas(T) unsigned char bytes[sizeof(T)];
+    };
+
+    Slot* slots_ = nullptr;
+    size_t capacity_;
+    size_t mapped_bytes_ = 0;
+    bool huge_pages_ = false;
+    std::unique_ptr<std::atomic<uint32_t>[]> next_;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> head_{NIL};  // tag << 32 | index
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> in_use_{0};
+    std::atomic<size_t> high_water_mark_{0};
+    std::atomic<uint64_t> exhausted_count_{0};
+
+    static uint64_t pack(uint64_t head, uint32_t index) {
+        return (((head >> 32) + 1) << 32) | index;
+    }
+
+    void map_slab(bool huge_pages) {
+        size_t bytes = std::max<size_t>(capacity_ * sizeof(Slot), 1);
+        void* mem = MAP_FAILED;
+        if (huge_pages) {
+            mapped_bytes_ = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+            mem = mmap(nullptr, mapped_bytes_, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+            huge_pages_ = mem != MAP_FAILED;
+        }
+        if (mem == MAP_FAILED) {
+            // No reserved huge pages: fall back to normal pages and ask for transparent huge pages
+            mapped_bytes_ = bytes;
+            mem = mmap(nullptr, mapped_bytes_, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+            if (mem == MAP_FAILED) {
+                throw std::bad_alloc();
+            }
+            if (huge_pages) {
+                madvise(mem, mapped_bytes_, MADV_HUGEPAGE);
+            }
+        }
+        slots_ = static_cast<Slot*>(mem);
+    }
+
+public:
+    explicit LockFreeAllocator(size_t capacity = 1024, bool huge_pages = false)
+        : capacity_(capacity), next_(new std::atomic<uint32_t>[capacity]) {
+        if (capacity >= NIL) {
+            throw std::invalid_argument("Pool capacity exceeds 32-bit slot index");
+        }
+        map_slab(huge_pages);
+        for (size_t i = 0; i < capacity_; ++i) {
+            next_[i].store(i + 1 < capacity_ ? static_cast<uint32_t>(i + 1) : NIL,
+                           std::memory_order_relaxed);
+        }
+        head_.store(capacity_ ? 0 : NIL, std::memory_order_release);
+    }
+
+    LockFreeAllocator(const LockFreeAllocator&) = delete;
+    LockFreeAllocator& operator=(const LockFreeAllocator&) = delete;
+
+    // Objects still allocated are not destroyed
+    ~LockFreeAllocator() {
+        munmap(slots_, mapped_bytes_);
+    }
+
+    // Uninitialised storage for one T, or nullptr if the pool is exhausted
+    T* allocate() {
+        uint64_t head = head_.load(std::memory_order_acquire);
+        uint32_t index;
+        do {
+            index = static_cast<uint32_t>(head);
+            if (index == NIL) {
+                exhausted_count_.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+        } while (!head_.compare_exchange_weak(
+            head, pack(head, next_[index].load(std::memory_order_relaxed)),
+            std::memory_order_acquire, std::memory_order_acquire));
+
+        size_t used = in_use_.fetch_add(1, std::memory_order_relaxed) + 1;
+        size_t peak = high_water_mark_.load(std::memory_order_relaxed);
+        while (used > peak &&
+               !high_water_mark_.compare_exchange_weak(peak, used, std::memory_order_relaxed)) {}
+        return reinterpret_cast<T*>(slots_[index].bytes);
+    }
+
+    // Returns storage to the pool; may be called from any thread
+    void deallocate(T* ptr) {
+        if (!ptr) return;
+        uint32_t index = index_of(ptr);
+        // Before the slot is back on the stack, so a racing allocate never counts past capacity
+        in_use_.fetch_sub(1, std::memory_order_relaxed);
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        do {
+            next_[index].store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+        } while (!head_.compare_exchange_weak(head, pack(head, index),
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed));
+    }
+
+    template<typename... Args>
+    T* create(Args&&... args) {
+        T* ptr = allocate();
+        return ptr ? new (ptr) T(std::forward<Args>(args)...) : nullptr;
+    }
+
+    void destroy(T* ptr) {
+        if (!ptr) return;
+        ptr->~T();
+        deallocate(ptr);
+    }
+
+    // Slot indices let owners link pooled objects with 32-bit handles instead of pointers
+    uint32_t index_of(const T* ptr) const {
+        return static_cast<uint32_t>(reinterpret_cast<const Slot*>(ptr) - slots_);
+    }
+
+    T& operator[](uint32_t index) {
+        return *std::launder(reinterpret_cast<T*>(slots_[index].bytes));
+    }
+
+    const T& operator[](uint32_t index) const {
+        return *std::launder(reinterpret_cast<const T*>(slots_[index].bytes));
+    }
+
+    bool owns(const T* ptr) const {
+        auto slot = reinterpret_cast<const Slot*>(ptr);
+        return slot >= slots_ && slot < slots_ + capacity_;
+    }
+
+    size_t capacity() const { return capacity_; }
+    size_t in_use() const { return in_use_.load(std::memory_order_relaxed); }
+    size_t high_water_mark() const { return high_water_mark_.load(std::memory_order_relaxed); }
+    uint64_t exhausted_count() const { return exhausted_count_.load(std::memory_order_relaxed); }
+    bool huge_pages() const { return huge_pages_; }
+};
+
+// Single-writer sequence lock. The writer never waits; readers copy the payload and retry only
+// if a write overlapped the copy. The payload is held in relaxed atomic words so concurrent
+// reads and writes stay well-defined (and visible to TSAN, which does not model fences).
+template<typename T>
+class SeqLock {
+private:
+    static_assert(std::is_trivially_copyable_v<T>, "SeqLock payload must be trivially copyable");
+    static constexpr size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    alignas(64) std::atomic<uint64_t> seq_{0};
+    std::atomic<uint64_t> data_[WORDS] = {};
+
+public:
+    void store(const T& value) {
+        uint64_t words[WORDS] = {};
+        std::memcpy(words, &value, sizeof(T));
+        uint64_t seq = seq_.load(std::memory_order_relaxed);
+        // Release on each word orders it after the odd sequence store; free on x86
+        seq_.store(seq + 1, std::memory_order_relaxed);
+        for (size_t i = 0; i < WORDS; ++i) {
+            data_[i].store(words[i], std::memory_order_release);
+        }
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+
+    T load() const {
+        uint64_t words[WORDS];
+        uint64_t before, after;
+        do {
+            before = seq_.load(std::memory_order_acquire);
+            for (size_t i = 0; i < WORDS; ++i) {
+                words[i] = data_[i].load(std::memory_order_acquire);
+            }
+            after = seq_.load(std::memory_order_relaxed);
+        } while (before != after || (before & 1));
+        T value;
+        std::memcpy(&value, words, sizeof(T));
+        return value;
+    }
+
+    // Even values count completed writes, odd means a write is in progress
+    uint64_t version() const {
+        return seq_.load(std::memory_order_acquire);
+    }
+};
+
+// Published best bid/offer, readable from any thread without locking
+struct TopOfBook {
+    Price bid;
+    Price ask;
+    size_t bid_size;
+    size_t ask_size;
+    std::chrono::nanoseconds timestamp;
+    uint64_t sequence;  // Incremented on every BBO change
+};
+
+// Rolling statistics over a fixed-capacity ring of samples, O(1) per sample with no allocation.
+// Mean and M2 follow Welford's update, with the add-and-evict step applied as a single replacement
+// once the window is full. The sums are rebuilt from the ring every RECENTER_WINDOWS windows to
+// shed accumulated rounding error. An EWMA variance (RiskMetrics style, zero-mean) can run alongside.
+template<size_t Capacity>
+class RollingStats {
+private:
+    static_assert(Capacity >= 2, "RollingStats needs room for at least two samples");
+    static constexpr size_t RECENTER_WINDOWS = 64;
+
+    double values_[Capacity] = {};
+    size_t window_ = Capacity;
+    size_t head_ = 0;   // Next slot to write (oldest sample once full)
+    size_t count_ = 0;
+    size_t since_recenter_ = 0;
+    double mean_ = 0.0;
+    double m2_ = 0.0;
+    double ewma_lambda_ = 0.0;  // 0 disables the EWMA
+    double ewma_variance_ = 0.0;
+    bool ewma_seeded_ = false;
+
+    void recenter() {
+        double sum = 0.0;
+        for (size_t i = 0; i < count_; ++i) sum += values_[i];
+        mean_ = sum / static_cast<double>(count_);
+        double m2 = 0.0;
+        for (size_t i = 0; i < count_; ++i) {
+            double d = values_[i] - mean_;
+            m2 += d * d;
+        }
+        m2_ = m2;
+        since_recenter_ = 0;
+    }
+
+public:
+    // Clears the samples; window is clamped to [2, Capacity]
+    void set_window(size_t window) {
+        window_ = std::clamp<size_t>(window, 2, Capacity);
+        head_ = count_ = since_recenter_ = 0;
+        mean_ = m2_ = 0.0;
+    }
+
+    // lambda in (0, 1), e.g. 0.94; 0 turns the EWMA off
+    void set_ewma(double lambda) {
+        ewma_lambda_ = lambda;
+        ewma_variance_ = 0.0;
+        ewma_seeded_ = false;
+    }
+
+    void add(double x) {
+        if (count_ < window_) {
+            ++count_;
+            double delta = x - mean_;
+            mean_ += delta / static_cast<double>(count_);
+            m2_ += delta * (x - mean_);
+        } else {
+            double old = values_[head_];
+            double old_mean = mean_;
+            mean_ += (x - old) / static_cast<double>(window_);
+            m2_ += (x - old) * (x - mean_ + old - old_mean);
+        }
+        values_[head_] = x;
+        if (++head_ == window_) head_ = 0;
+        if (++since_recenter_ == RECENTER_WINDOWS * window_) recenter();
+
+        if (ewma_lambda_ > 0.0) {
+            ewma_variance_ = ewma_seeded_
+                ? ewma_lambda_ * ewma_variance_ + (1.0 - ewma_lambda_) * x * x
+                : x * x;
+            ewma_seeded_ = true;
+        }
+    }
+
+    size_t count() const { return count_; }
+    size_t window() const { return window_; }
+    double mean() const { return mean_; }
+
+    // Population variance over the window, matching sum_sq / n - mean^2
+    double variance() const {
+        return count_ ? std::max(0.0, m2_ / static_cast<double>(count_)) : 0.0;
+    }
+
+    double stddev() const { return std::sqrt(variance()); }
+    double ewma_variance() const { return ewma_variance_; }
+
+    // Samples oldest to newest
+    template<typename F>
+    void for_each(F&& fn) const {
+        size_t start = count_ < window_ ? 0 : head_;
+        for (size_t i = 0; i < count_; ++i) {
+            size_t idx = start + i;
+            fn(values_[idx < window_ ? idx : idx - window_]);
+        }
+    }
+};
+
+// Volatility of log returns fed with prices
+template<size_t Capacity>
+class RollingVolatility {
+private:
+    RollingStats<Capacity> returns_;
+    double last_price_ = 0.0;
+    bool use_ewma_ = false;
+
+public:
+    void set_window(size_t window) { returns_.set_window(window); }
+
+    void set_ewma(double lambda) {
+        returns_.set_ewma(lambda);
+        use_ewma_ = lambda > 0.0;
+    }
+
+    void update(double price) {
+        if (price <= 0.0) {
+            return;
+        }
+        if (last_price_ > 0.0) {
+            returns_.add(std::log(price / last_price_));
+        }
+        last_price_ = price;
+    }
+
+    // Zero until at least two returns have been seen
+    double volatility() const {
+        if (returns_.count() < 2) {
+            return 0.0;
+        }
+        return use_ewma_ ? std::sqrt(returns_.ewma_variance()) : returns_.stddev();
+    }
+
+    const RollingStats<Capacity>& returns() const { return returns_; }
+};
+
+// Open-addressing map from numeric id to a value, fixed capacity, no allocation after construction
+template<typename V>
+class FlatIdMap {
+private:
+    static constexpr uint64_t EMPTY_KEY = ~uint64_t{0};
+
+    struct Slot {
+        uint64_t key;
+        V value;
+    };
+
+    std::vector<Slot> slots_;
+    size_t mask_;
+    size_t size_ = 0;
+
+    size_t home(uint64_t key) const {
+        return (key * 0x9E3779B97F4A7C15ull) >> 17 & mask_;
+    }
+
+public:
+    explicit FlatIdMap(size_t capacity) {
+        size_t n = 16;
+        while (n < capacity * 2) n <<= 1;  // keep load factor <= 0.5
+        slots_.assign(n, Slot{EMPTY_KEY, V{}});
+        mask_ = n - 1;
+    }
+
+    size_t size() const { return size_; }
+
+    bool insert(uint64_t key, const V& value) {
+        if (key == EMPTY_KEY || (size_ + 1) * 2 > slots_.size()) {
+            return false;
+        }
+        for (size_t i = home(key);; i = (i + 1) & mask_) {
+            if (slots_[i].key == EMPTY_KEY) {
+                slots_[i] = Slot{key, value};
+                ++size_;
+                return true;
+            }
+            if (slots_[i].key == key) {
+                return false;  // Duplicate id
+            }
+        }
+    }
+
+    V* find(uint64_t key) {
+        for (size_t i = home(key);; i = (i + 1) & mask_) {
+            if (slots_[i].key == key) return &slots_[i].value;
+            if (slots_[i].key == EMPTY_KEY) return nullptr;
+        }
+    }
+
+    const V* find(uint64_t key) const {
+        return const_cast<FlatIdMap*>(this)->find(key);
+    }
+
+    bool erase(uint64_t key) {
+        size_t i = home(key);
+        while (slots_[i].key != key) {
+            if (slots_[i].key == EMPTY_KEY) return false;
+            i = (i + 1) & mask_;
+        }
+        // Backward-shift deletion keeps probe chains intact without tombstones
+        for (size_t j = (i + 1) & mask_;; j = (j + 1) & mask_) {
+            if (slots_[j].key == EMPTY_KEY) break;
+            size_t h = home(slots_[j].key);
+            if (((j - h) & mask_) >= ((j - i) & mask_)) {
+                slots_[i] = slots_[j];
+                i = j;
+            }
+        }
+        slots_[i].key = EMPTY_KEY;
+        --size_;
+        return true;
+    }
+};
+
+// Order book implementation
+// Price levels live in a flat array indexed by tick offset from an anchor price, one array per
+// side, with a bitmap of non-empty levels so the next best level is found a word at a time.
+// Best bid/ask indices are cached, so top-of-book is O(1). Individual orders (L3) are kept in
+// per-level intrusive FIFO lists whose nodes come from a preallocated pool.
+// The book has a single writer (the market data thread). Every BBO change is published through
+// a seqlock so strategy threads read top-of-book without touching the writer.
+class OrderBook {
+private:
+    static constexpr uint32_t NIL = ~uint32_t{0};
+    static constexpr size_t NO_LEVEL = ~size_t{0};
+
+    struct OrderNode {
+        uint64_t order_id;
+        size_t quantity;
+        uint32_t level;
+        uint32_t prev;
+        uint32_t next;
+        bool is_buy;
+    };
+
+    struct Level {
+        size_t quantity = 0;
+        uint32_t order_count = 0;
+        uint32_t head = NIL;
+        uint32_t tail = NIL;
+    };
+
+    struct Side {
+        std::vector<Level> levels;
+        std::vector<uint64_t> occupied;  // One bit per non-empty level
+        size_t best = NO_LEVEL;
+    };
+
+    SymbolId symbol_;
+    Price base_tick_ = 0;
+    bool anchored_ = false;
+    size_t num_levels_;
+    Side bids_;
+    Side asks_;
+
+    // Pooled L3 order storage
+    LockFreeAllocator<OrderNode> nodes_;
+    FlatIdMap<uint32_t> order_index_;
+
+    // Written by the book's thread only, read by the metrics exporter
+    std::atomic<uint64_t> recenters_{0};
+    std::atomic<uint64_t> out_of_window_{0};  // Updates refused because their price was outside the window
+
+    // Published top-of-book
+    TopOfBook last_published_{};
+    std::chrono::nanoseconds last_timestamp_{0};
+    SeqLock<TopOfBook> top_of_book_;
+
+    // Publishes the BBO on scope exit if any mutation changed it
+    class PublishOnExit {
+    private:
+        OrderBook& book_;
+
+    public:
+        explicit PublishOnExit(OrderBook& book) : book_(book) {}
+        ~PublishOnExit() { book_.publish(); }
+    };
+
+public:
+    explicit OrderBook(SymbolId symbol,
+                       size_t num_levels = 4096,
+                       size_t max_orders = 65536,
+                       Price anchor_price = 0,
+                       bool huge_pages = false)
+        : symbol_(symbol), num_levels_(num_levels),
+          nodes_(max_orders, huge_pages), order_index_(max_orders) {
+        for (Side* side : {&bids_, &asks_}) {
+            side->levels.resize(num_levels_);
+            side->occupied.assign((num_levels_ + 63) / 64, 0);
+        }
+        if (anchor_price > 0) {
+            anchor(anchor_price);
+        }
+    }
+
+    SymbolId symbol() const { return symbol_; }
+
+    // L1 update: the quote's prices become the best levels, anything better on either side is stale
+    bool update(const Quote& quote) {
+        PublishOnExit publish(*this);
+        last_timestamp_ = quote.timestamp;
+        size_t bid = level_index(quote.bid);
+        size_t ask = level_index(quote.ask);
+        if ((bid == NO_LEVEL || ask == NO_LEVEL) && quote.bid > 0 && quote.ask >= quote.bid &&
+            quote.ask - quote.bid < static_cast<Price>(num_levels_)) {
+            // The market has drifted out of the window: follow it
+            recenter(quote.bid + (quote.ask - quote.bid) / 2);
+            bid = level_index(quote.bid);
+            ask = level_index(quote.ask);
+        }
+        if (bid == NO_LEVEL || ask == NO_LEVEL) {
+            out_of_window_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        clear_better_than(bids_, true, bid);
+        clear_better_than(asks_, false, ask);
+        set_level_quantity(bids_, true, bid, quote.bid_size);
+        set_level_quantity(asks_, false, ask, quote.ask_size);
+        return true;
+    }
+
+    // L2 update: set aggregate quantity at a price, zero deletes the level
+    bool set_level(bool is_buy, Price price, size_t quantity, std::chrono::nanoseconds timestamp = {}) {
+        PublishOnExit publish(*this);
+        stamp(timestamp);
+        size_t idx = level_index(price);
+        if (idx == NO_LEVEL) {
+            out_of_window_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        set_level_quantity(side(is_buy), is_buy, idx, quantity);
+        return true;
+    }
+
+    // L3 updates by order id
+    bool add_order(uint64_t order_id, bool is_buy, Price price, size_t quantity, std::chrono::nanoseconds timestamp = {}) {
+        PublishOnExit publish(*this);
+        stamp(timestamp);
+        size_t idx = level_index(price);
+        if (idx == NO_LEVEL) {
+            out_of_window_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        if (quantity == 0) {
+            return false;
+        }
+        OrderNode* node = nodes_.allocate();
+        if (!node) {
+            return false;
+        }
+        uint32_t n = nodes_.index_of(node);
+        if (!order_index_.insert(order_id, n)) {
+            nodes_.deallocate(node);
+            return false;
+        }
+        new (node) OrderNode{order_id, quantity, static_cast<uint32_t>(idx), NIL, NIL, is_buy};
+        link_back(side(is_buy), n);
+        return true;
+    }
+
+    // Quantity decrease keeps queue position, increase moves the order to the back
+    bool modify_order(uint64_t order_id, size_t new_quantity, std::chrono::nanoseconds timestamp = {}) {
+        PublishOnExit publish(*this);
+        stamp(timestamp);
+        const uint32_t* n = order_index_.find(order_id);
+        if (!n) {
+            return false;
+        }
+        if (new_quantity == 0) {
+            remove_order(*n);
+            return true;
+        }
+        OrderNode& node = nodes_[*n];
+        Level& level = side(node.is_buy).levels[node.level];
+        if (new_quantity > node.quantity) {
+            unlink(side(node.is_buy), *n);
+            node.quantity = new_quantity;
+            link_back(side(node.is_buy), *n);
+        } else {
+            level.quantity -= node.quantity - new_quantity;
+            node.quantity = new_quantity;
+        }
+        return true;
+    }
+
+    bool cancel_order(uint64_t order_id, std::chrono::nanoseconds timestamp = {}) {
+        PublishOnExit publish(*this);
+        stamp(timestamp);
+        const uint32_t* n = order_index_.find(order_id);
+        if (!n) {
+            return false;
+        }
+        remove_order(*n);
+        return true;
+    }
+
+    bool execute_order(uint64_t order_id, size_t quantity, std::chrono::nanoseconds timestamp = {}) {
+        PublishOnExit publish(*this);
+        stamp(timestamp);
+        const uint32_t* n = order_index_.find(order_id);
+        if (!n) {
+            return false;
+        }
+        OrderNode& node = nodes_[*n];
+        if (quantity >= node.quantity) {
+            remove_order(*n);
+        } else {
+            node.quantity -= quantity;
+            side(node.is_buy).levels[node.level].quantity -= quantity;
+        }
+        return true;
+    }
+
+    // Crosses an incoming order against the opposite side in price-time priority. on_fill is
+    // called as (resting order id, price, quantity) for each execution and must not touch the
+    // book. Levels that only carry L2 quantity are never matched. Returns the unfilled quantity.
+    template<typename OnFill>
+    size_t match(bool is_buy, Price limit, size_t quantity, OnFill&& on_fill,
+                 std::chrono::nanoseconds timestamp = {}) {
+        PublishOnExit publish(*this);
+        stamp(timestamp);
+        Side& opposite = side(!is_buy);
+        while (quantity > 0 && opposite.best != NO_LEVEL) {
+            Price price = to_price(opposite.best);
+            Level& level = opposite.levels[opposite.best];
+            if ((is_buy ? price > limit : price < limit) || level.head == NIL) {
+                break;
+            }
+            uint32_t n = level.head;
+            OrderNode& node = nodes_[n];
+            size_t traded = std::min(quantity, node.quantity);
+            on_fill(node.order_id, price, traded);
+            quantity -= traded;
+            if (traded == node.quantity) {
+                remove_order(n);
+            } else {
+                node.quantity -= traded;
+                level.quantity -= traded;
+            }
+        }
+        return quantity;
+    }
+
+    // Quantity queued ahead of an order at its level; writer-thread only
+    size_t queue_ahead(uint64_t order_id) const {
+        const uint32_t* n = order_index_.find(order_id);
+        if (!n) {
+            return 0;
+        }
+        size_t ahead = 0;
+        for (uint32_t i = side(nodes_[*n].is_buy).levels[nodes_[*n].level].head; i != *n; i = nodes_[i].next) {
+            ahead += nodes_[i].quantity;
+        }
+        return ahead;
+    }
+
+    // Writer-thread only
+    size_t level_quantity(bool is_buy, Price price) const {
+        size_t idx = level_index(price);
+        return idx == NO_LEVEL ? 0 : side(is_buy).levels[idx].quantity;
+    }
+
+    // Safe from any thread
+    TopOfBook top_of_book() const {
+        return top_of_book_.load();
+    }
+
+    // L3 node pool; its counters are atomics, so any thread may read them
+    const auto& node_pool() const { return nodes_; }
+
+    // Lowest price the level window covers; writer-thread only
+    Price window_base() const { return base_tick_; }
+
+    // Safe from any thread
+    uint64_t recenters() const { return recenters_.load(std::memory_order_relaxed); }
+    uint64_t out_of_window() const { return out_of_window_.load(std::memory_order_relaxed); }
+
+    Quote get_top_of_book() const {
+        TopOfBook top = top_of_book_.load();
+        Quote quote{};
+        quote.symbol = symbol_;
+        quote.bid = top.bid;
+        quote.ask = top.ask;
+        quote.bid_size = top.bid_size;
+        quote.ask_size = top.ask_size;
+        quote.timestamp = top.timestamp;
+        return quote;
+    }
+
+private:
+    void stamp(std::chrono::nanoseconds timestamp) {
+        if (timestamp.count() != 0) {
+            last_timestamp_ = timestamp;
+        }
+    }
+
+    void publish() {
+        TopOfBook top{};
+        if (bids_.best != NO_LEVEL) {
+            top.bid = to_price(bids_.best);
+            top.bid_size = bids_.levels[bids_.best].quantity;
+        }
+        if (asks_.best != NO_LEVEL) {
+            top.ask = to_price(asks_.best);
+            top.ask_size = asks_.levels[asks_.best].quantity;
+        }
+        if (top.bid == last_published_.bid && top.ask == last_published_.ask &&
+            top.bid_size == last_published_.bid_size && top.ask_size == last_published_.ask_size) {
+            return;
+        }
+        top.timestamp = last_timestamp_;
+        top.sequence = last_published_.sequence + 1;
+        last_published_ = top;
+        top_of_book_.store(top);
+    }
+
+    Side& side(bool is_buy) { return is_buy ? bids_ : asks_; }
+    const Side& side(bool is_buy) const { return is_buy ? bids_ : asks_; }
+
+    Price to_price(size_t idx) const {
+        return base_tick_ + static_cast<Price>(idx);
+    }
+
+    void anchor(Price tick) {
+        base_tick_ = std::max<Price>(0, tick - static_cast<Price>(num_levels_ / 2));
+        anchored_ = true;
+    }
+
+    // Slides the window so center sits in its middle. Levels still inside keep their quantity and
+    // queued orders; the rest are dropped. O(num_levels), paid only when the market drifts.
+    void recenter(Price center) {
+        Price base = std::max<Price>(0, center - static_cast<Price>(num_levels_ / 2));
+        Price shift = base - base_tick_;
+        if (shift == 0) {
+            return;
+        }
+        shift_levels(bids_, shift);
+        shift_levels(asks_, shift);
+        bids_.best = next_below(bids_, num_levels_);
+        asks_.best = next_above(asks_, NO_LEVEL);  // NO_LEVEL + 1 wraps to the first level
+        base_tick_ = base;
+        recenters_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Moves level idx to idx - shift. Walking away from the direction of travel means every
+    // destination has already been vacated.
+    void shift_levels(Side& s, Price shift) {
+        auto levels = static_cast<Price>(num_levels_);
+        for (Price i = 0; i < levels; ++i) {
+            auto idx = static_cast<size_t>(shift > 0 ? i : levels - 1 - i);
+            uint64_t bit = uint64_t{1} << (idx % 64);
+            if (!(s.occupied[idx / 64] & bit)) {
+                continue;
+            }
+            s.occupied[idx / 64] &= ~bit;
+            Price to = static_cast<Price>(idx) - shift;
+            if (to < 0 || to >= levels) {
+                clear_orders(s, idx);
+                s.levels[idx] = Level{};
+                continue;
+            }
+            auto dest = static_cast<size_t>(to);
+            s.levels[dest] = s.levels[idx];
+            s.levels[idx] = Level{};
+            for (uint32_t n = s.levels[dest].head; n != NIL; n = nodes_[n].next) {
+                nodes_[n].level = static_cast<uint32_t>(dest);
+            }
+            s.occupied[dest / 64] |= uint64_t{1} << (dest % 64);
+        }
+    }
+
+    // Books without an explicit anchor centre their window on the first price seen
+    size_t level_index(Price price) {
+        if (!anchored_) {
+            anchor(price);
+        }
+        return static_cast<const OrderBook*>(this)->level_index(price);
+    }
+
+    size_t level_index(Price price) const {
+        Price offset = price - base_tick_;
+        if (!anchored_ || offset < 0 || offset >= static_cast<Price>(num_levels_)) {
+            return NO_LEVEL;
+        }
+        return static_cast<size_t>(offset);
+    }
+
+    static bool better(bool is_buy, size_t a, size_t b) {
+        return is_buy ? a > b : a < b;
+    }
+
+    void mark_occupied(Side& s, bool is_buy, size_t idx) {
+        s.occupied[idx / 64] |= uint64_t{1} << (idx % 64);
+        if (s.best == NO_LEVEL || better(is_buy, idx, s.best)) {
+            s.best = idx;
+        }
+    }
+
+    void mark_empty(Side& s, bool is_buy, size_t idx) {
+        s.occupied[idx / 64] &= ~(uint64_t{1} << (idx % 64));
+        if (s.best == idx) {
+            s.best = is_buy ? next_below(s, idx) : next_above(s, idx);
+        }
+    }
+
+    // Highest occupied level strictly below idx
+    static size_t next_below(const Side& s, size_t idx) {
+        if (idx == 0) return NO_LEVEL;
+        size_t i = idx - 1;
+        size_t w = i / 64;
+        uint64_t bits = s.occupied[w] & (~uint64_t{0} >> (63 - i % 64));
+        while (true) {
+            if (bits) return w * 64 + 63 - static_cast<size_t>(__builtin_clzll(bits));
+            if (w == 0) return NO_LEVEL;
+            bits = s.occupied[--w];
+        }
+    }
+
+    // Lowest occupied level strictly above idx
+    size_t next_above(const Side& s, size_t idx) const {
+        size_t i = idx + 1;
+        if (i >= num_levels_) return NO_LEVEL;
+        size_t w = i / 64;
+        uint64_t bits = s.occupied[w] & (~uint64_t{0} << (i % 64));
+        while (true) {
+            if (bits) return w * 64 + static_cast<size_t>(__builtin_ctzll(bits));
+            if (++w == s.occupied.size()) return NO_LEVEL;
+            bits = s.occupied[w];
+        }
+    }
+
+    void set_level_quantity(Side& s, bool is_buy, size_t idx, size_t quantity) {
+        clear_orders(s, idx);
+        s.levels[idx].quantity = quantity;
+        if (quantity) {
+            mark_occupied(s, is_buy, idx);
+        } else {
+            mark_empty(s, is_buy, idx);
+        }
+    }
+
+    void clear_better_than(Side& s, bool is_buy, size_t idx) {
+        while (s.best != NO_LEVEL && better(is_buy, s.best, idx)) {
+            set_level_quantity(s, is_buy, s.best, 0);
+        }
+    }
+
+    void link_back(Side& s, uint32_t n) {
+        OrderNode& node = nodes_[n];
+        Level& level = s.levels[node.level];
+        node.prev = level.tail;
+        node.next = NIL;
+        if (level.tail != NIL) {
+            nodes_[level.tail].next = n;
+        } else {
+            level.head = n;
+        }
+        level.tail = n;
+        level.quantity += node.quantity;
+        ++level.order_count;
+        mark_occupied(s, node.is_buy, node.level);
+    }
+
+    void unlink(Side& s, uint32_t n) {
+        OrderNode& node = nodes_[n];
+        Level& level = s.levels[node.level];
+        if (node.prev != NIL) nodes_[node.prev].next = node.next; else level.head = node.next;
+        if (node.next != NIL) nodes_[node.next].prev = node.prev; else level.tail = node.prev;
+        level.quantity -= node.quantity;
+        --level.order_count;
+        if (level.order_count == 0) {
+            level.quantity = 0;
+            mark_empty(s, node.is_buy, node.level);
+        }
+    }
+
+    void release_node(uint32_t n) {
+        order_index_.erase(nodes_[n].order_id);
+        nodes_.deallocate(&nodes_[n]);
+    }
+
+    void remove_order(uint32_t n) {
+        unlink(side(nodes_[n].is_buy), n);
+        release_node(n);
+    }
+
+    // Drops any L3 orders resting at a level that is being overwritten by an L2/L1 update
+    void clear_orders(Side& s, size_t idx) {
+        Level& level = s.levels[idx];
+        for (uint32_t n = level.head; n != NIL;) {
+            uint32_t next = nodes_[n].next;
+            release_node(n);
+            n = next;
+        }
+        level.head = level.tail = NIL;
+        level.order_count = 0;
+    }
+};
+
+// Pipeline stages timed on the hot path
+enum class LatencyStage : uint8_t {
+    QuoteQueue,        // MarketDataHandler::on_quote -> shard dequeue
+    BookUpdate,        // OrderBook::update
+    StrategyInbox,     // Shard thread -> queued strategy thread
+    StrategyDecision,  // Time spent in a strategy callback
+    RiskCheck,         // RiskManager::check_order
+    OrderQueue,        // Order timestamp -> OrderManager::process_order
+    OrderProcess,      // OrderManager::process_order
+    COUNT
+};
+
+inline const char* latency_stage_name(LatencyStage stage) {
+    static constexpr const char* NAMES[] = {
+        "quote_queue", "book_update", "strategy_inbox", "strategy_decision",
+        "risk_check", "order_queue", "order_process",
+    };
+    return NAMES[static_cast<size_t>(stage)];
+}
+
+struct LatencySummary {
+    uint64_t count;
+    double mean;
+    uint64_t p50;
+    uint64_t p99;
+    uint64_t p999;
+    uint64_t max;
+};
+
+// Log-linear (HDR-style) histogram of nanosecond samples: exact below 32 ns, then 32 sub-buckets
+// per power of two, about 3% relative error. One thread writes it with plain relaxed stores;
+// any thread may read it concurrently to take a snapshot.
+class LatencyHistogram {
+public:
+    static constexpr unsigned SUB_BITS = 5;
+    static constexpr size_t SUB_BUCKETS = size_t{1} << SUB_BITS;
+    static constexpr size_t BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+
+    static size_t bucket_of(uint64_t value) {
+        if (value < SUB_BUCKETS) {
+            return static_cast<size_t>(value);
+        }
+        unsigned shift = 63 - static_cast<unsigned>(__builtin_clzll(value)) - SUB_BITS;
+        return (shift + 1) * SUB_BUCKETS + ((value >> shift) & (SUB_BUCKETS - 1));
+    }
+
+    // Lowest value that falls in a bucket
+    static uint64_t bucket_value(size_t bucket) {
+        if (bucket < SUB_BUCKETS) {
+            return bucket;
+        }
+        size_t shift = bucket / SUB_BUCKETS - 1;
+        return (SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+    }
+
+    void record(uint64_t value) {
+        bump(buckets_[bucket_of(value)], 1);
+        bump(count_, 1);
+        bump(sum_, value);
+        if (value > max_.load(std::memory_order_relaxed)) {
+            max_.store(value, std::memory_order_relaxed);
+        }
+    }
+
+    // Adds this histogram's buckets into counts (size BUCKETS)
+    void accumulate(std::vector<uint64_t>& counts, uint64_t& count, uint64_t& sum,
+                    uint64_t& max) const {
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            counts[i] += buckets_[i].load(std::memory_order_relaxed);
+        }
+        count += count_.load(std::memory_order_relaxed);
+        sum += sum_.load(std::memory_order_relaxed);
+        max = std::max(max, max_.load(std::memory_order_relaxed));
+    }
+
+    static LatencySummary summarize(const std::vector<uint64_t>& counts, uint64_t count,
+                                    uint64_t sum, uint64_t max) {
+        LatencySummary summary{count, count ? static_cast<double>(sum) / count : 0.0, 0, 0, 0, max};
+        uint64_t* targets[] = {&summary.p50, &summary.p99, &summary.p999};
+        const double quantiles[] = {0.50, 0.99, 0.999};
+        uint64_t seen = 0;
+        size_t next = 0;
+        for (size_t i = 0; i < BUCKETS && next < 3; ++i) {
+            seen += counts[i];
+            while (next < 3 && seen > 0 && seen >= quantiles[next] * count) {
+                *targets[next++] = std::min(bucket_value(i), max);
+            }
+        }
+        return summary;
+    }
+
+private:
+    // Single-writer increment: no locked RMW needed
+    static void bump(std::atomic<uint64_t>& counter, uint64_t delta) {
+        counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> buckets_[BUCKETS] = {};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+};
+
+// Owns one set of stage histograms per recording thread. Threads register on first use (the only
+// time the mutex is taken); snapshots merge all threads without stopping them.
+class LatencyRegistry {
+private:
+    static constexpr size_t STAGES = static_cast<size_t>(LatencyStage::COUNT);
+
+    struct ThreadHistograms {
+        LatencyHistogram stages[STAGES];
+    };
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<ThreadHistograms>> threads_;
+
+    ThreadHistograms* register_thread() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        threads_.push_back(std::make_unique<ThreadHistograms>());
+        return threads_.back().get();
+    }
+
+public:
+    static LatencyRegistry& instance();
+
+    static LatencyHistogram& local(LatencyStage stage) {
+        thread_local ThreadHistograms* histograms = instance().register_thread();
+        return histograms->stages[static_cast<size_t>(stage)];
+    }
+
+    LatencySummary summary(LatencyStage stage) const {
+        std::vector<uint64_t> counts(LatencyHistogram::BUCKETS, 0);
+        uint64_t count = 0, sum = 0, max = 0;
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& thread : threads_) {
+            thread->stages[static_cast<size_t>(stage)].accumulate(counts, count, sum, max);
+        }
+        return LatencyHistogram::summarize(counts, count, sum, max);
+    }
+
+    // Per-stage percentiles in nanoseconds, one line per stage that has samples
+    void report(std::ostream& out) const {
+        out << "stage                count      mean_ns   p50_ns   p99_ns  p99.9_ns   max_ns\n";
+        for (size_t i = 0; i < STAGES; ++i) {
+            LatencySummary s = summary(static_cast<LatencyStage>(i));
+            if (!s.count) continue;
+            char line[160];
+            std::snprintf(line, sizeof(line), "%-18s %9llu %10.1f %8llu %8llu %9llu %8llu\n",
+                          latency_stage_name(static_cast<LatencyStage>(i)),
+                          static_cast<unsigned long long>(s.count), s.mean,
+                          static_cast<unsigned long long>(s.p50),
+                          static_cast<unsigned long long>(s.p99),
+                          static_cast<unsigned long long>(s.p999),
+                          static_cast<unsigned long long>(s.max));
+            out << line;
+        }
+    }
+};
+
+inline void record_latency(LatencyStage stage, int64_t nanoseconds) {
+    LatencyRegistry::local(stage).record(nanoseconds > 0 ? static_cast<uint64_t>(nanoseconds) : 0);
+}
+
+// Times the enclosing scope into one stage
+class ScopedLatency {
+private:
+    LatencyStage stage_;
+    int64_t start_;
+
+public:
+    explicit ScopedLatency(LatencyStage stage) : stage_(stage), start_(LatencyClock::now_ns()) {}
+    ~ScopedLatency() { record_latency(stage_, LatencyClock::now_ns() - start_); }
+};
+
+// Why a risk check refused an order
+enum class RiskReject : uint8_t {
+    NoLimits,        // Symbol has no limits configured
+    MaxOrderSize,
+    MaxNetPosition,
+    VarLimit,        // AdvancedRiskManager: the position cap was derived from the VaR limit
+    EsLimit,         // ... from the expected shortfall limit
+    PortfolioVar,    // ... from the portfolio VaR limit
+    COUNT
+};
+
+inline const char* risk_reject_name(RiskReject reason) {
+    static constexpr const char* NAMES[] = {
+        "no_limits", "max_order_size", "max_net_position", "var_limit", "es_limit", "portfolio_var",
+    };
+    return NAMES[static_cast<size_t>(reason)];
+}
+
+// Events counted on the hot path. The risk rejects are one contiguous run in RiskReject order.
+enum class Metric : uint8_t {
+    MarketDataQueueFull,   // MarketDataHandler shard ring full; the feed sees on_quote fail
+    StrategyInboxFull,     // Queued strategy inbox full; the event is dropped
+    OrderQueueFull,        // OrderManager request queue full; the caller sees QueueFull
+    GatewayFull,           // Gateway refused a new order, amend or cancel
+    VenueRejected,         // Venue rejected an order
+    OrderOverfill,         // Venue filled more than the acknowledged quantity
+    RiskRejected,          // First of RiskReject::COUNT counters
+    COUNT = RiskRejected + static_cast<uint8_t>(RiskReject::COUNT)
+};
+
+inline Metric risk_reject_metric(RiskReject reason) {
+    return static_cast<Metric>(static_cast<uint8_t>(Metric::RiskRejected) + static_cast<uint8_t>(reason));
+}
+
+// Prometheus family (without the llsys_ prefix) and label set of a counter
+struct MetricName {
+    const char* family;
+    const char* labels;
+};
+
+inline MetricName metric_name(Metric metric) {
+    static constexpr MetricName NAMES[] = {
+        {"queue_full_total", "queue=\"market_data\""},
+        {"queue_full_total", "queue=\"strategy_inbox\""},
+        {"queue_full_total", "queue=\"order_requests\""},
+        {"order_rejects_total", "reason=\"gateway_full\""},
+        {"order_rejects_total", "reason=\"venue_rejected\""},
+        {"order_anomalies_total", "kind=\"overfill\""},
+        {"risk_rejects_total", "reason=\"no_limits\""},
+        {"risk_rejects_total", "reason=\"max_order_size\""},
+        {"risk_rejects_total", "reason=\"max_net_position\""},
+        {"risk_rejects_total", "reason=\"var_limit\""},
+        {"risk_rejects_total", "reason=\"es_limit\""},
+        {"risk_rejects_total", "reason=\"portfolio_var\""},
+    };
+    static_assert(std::size(NAMES) == static_cast<size_t>(Metric::COUNT), "One name per metric");
+    return NAMES[static_cast<size_t>(metric)];
+}
+
+// Occupancy of one queue as its consumer last saw it, and the deepest it has been. Only the
+// consumer thread writes it, on its own cache line.
+struct alignas(CACHE_LINE_SIZE) QueueGauge {
+    const size_t capacity;
+    std::atomic<uint64_t> depth{0};
+    std::atomic<uint64_t> high_water{0};
+
+    explicit QueueGauge(size_t queue_capacity) : capacity(queue_capacity) {}
+
+    void observe(size_t n) {
+        if (depth.load(std::memory_order_relaxed) != n) {
+            depth.store(n, std::memory_order_relaxed);
+        }
+        if (n > high_water.load(std::memory_order_relaxed)) {
+            high_water.store(n, std::memory_order_relaxed);
+        }
+    }
+};
+
+// Event counters and gauges for export. Counters follow LatencyRegistry: one cache-line-aligned
+// block per counting thread, registered on first use and bumped without a locked RMW; reads sum
+// every block. Gauges are read on demand through thunks registered at setup time, keyed by the
+// owning component, which removes them before it is destroyed.
+class MetricsRegistry {
+private:
+    static constexpr size_t COUNTERS = static_cast<size_t>(Metric::COUNT);
+
+    struct alignas(CACHE_LINE_SIZE) ThreadCounters {
+        std::atomic<uint64_t> counters[COUNTERS] = {};
+    };
+
+    struct Gauge {
+        const void* owner;
+        std::string family;
+        std::string labels;
+        const void* source;
+        double (*read)(const void* source);
+    };
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<ThreadCounters>> threads_;
+    std::vector<Gauge> gauges_;
+    std::vector<std::pair<std::string, size_t>> instances_;
+
+    ThreadCounters* register_thread() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        threads_.push_back(std::make_unique<ThreadCounters>());
+        return threads_.back().get();
+    }
+
+public:
+    static MetricsRegistry& instance();
+
+    static void count(Metric metric, uint64_t delta = 1) {
+        thread_local ThreadCounters* counters = instance().register_thread();
+        std::atomic<uint64_t>& counter = counters->counters[static_cast<size_t>(metric)];
+        counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    uint64_t counter(Metric metric) const {
+        uint64_t total = 0;
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& thread : threads_) {
+            total += thread->counters[static_cast<size_t>(metric)].load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    // Distinguishes components of one kind in gauge labels: 0, 1, ... in construction order
+    size_t next_instance(const std::string& kind) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& [name, count] : instances_) {
+            if (name == kind) return count++;
+        }
+        instances_.emplace_back(kind, 1);
+        return 0;
+    }
+
+    // read(source) runs on the exporting thread, so it may only touch atomics or immutable state
+    void add_gauge(const void* owner, std::string family, std::string labels, const void* source,
+                   double (*read)(const void* source)) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        gauges_.push_back(Gauge{owner, std::move(family), std::move(labels), source, read});
+    }
+
+    // A gauge that is a single atomic value
+    template<typename V>
+    void add_value(const void* owner, std::string family, std::string labels, const std::atomic<V>& value) {
+        add_gauge(owner, std::move(family), std::move(labels), &value, [](const void* v) {
+            return static_cast<double>(static_cast<const std::atomic<V>*>(v)->load(std::memory_order_relaxed));
+        });
+    }
+
+    void add_queue(const void* owner, const std::string& labels, const QueueGauge& gauge) {
+        add_value(owner, "queue_depth", labels, gauge.depth);
+        add_value(owner, "queue_high_water", labels, gauge.high_water);
+        add_gauge(owner, "queue_capacity", labels, &gauge, [](const void* g) {
+            return static_cast<double>(static_cast<const QueueGauge*>(g)->capacity);
+        });
+    }
+
+    template<typename T>
+    void add_pool(const void* owner, const std::string& labels, const LockFreeAllocator<T>& pool) {
+        using Pool = LockFreeAllocator<T>;
+        add_gauge(owner, "pool_in_use", labels, &pool, [](const void* p) {
+            return static_cast<double>(static_cast<const Pool*>(p)->in_use());
+        });
+        add_gauge(owner, "pool_high_water", labels, &pool, [](const void* p) {
+            return static_cast<double>(static_cast<const Pool*>(p)->high_water_mark());
+        });
+        add_gauge(owner, "pool_capacity", labels, &pool, [](const void* p) {
+            return static_cast<double>(static_cast<const Pool*>(p)->capacity());
+        });
+        add_gauge(owner, "pool_exhausted_total", labels, &pool, [](const void* p) {
+            return static_cast<double>(static_cast<const Pool*>(p)->exhausted_count());
+        });
+    }
+
+    // Once removed, none of the owner's thunks is running or will run again
+    void remove_gauges(const void* owner) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::erase_if(gauges_, [owner](const Gauge& gauge) { return gauge.owner == owner; });
+    }
+
+    // visit(family, labels, value) for every gauge, grouped by family in registration order
+    template<typename Visitor>
+    void visit_gauges(Visitor&& visit) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<bool> done(gauges_.size(), false);
+        for (size_t i = 0; i < gauges_.size(); ++i) {
+            for (size_t j = i; j < gauges_.size(); ++j) {
+                if (!done[j] && gauges_[j].family == gauges_[i].family) {
+                    visit(gauges_[j].family, gauges_[j].labels, gauges_[j].read(gauges_[j].source));
+                    done[j] = true;
+                }
+            }
+        }
+    }
+};
+
+inline void count_metric(Metric metric, uint64_t delta = 1) {
+    MetricsRegistry::count(metric, delta);
+}
+
+// Label value for a symbol, whether or not it was registered by name
+inline std::string metric_symbol_label(SymbolId symbol) {
+    return symbol < symbols().size() ? symbols().name(symbol) : std::to_string(symbol);
+}
+
+// Spin-loop hint: lets the sibling hyperthread run and avoids the memory-order flush on loop exit
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#endif
+}
+
+enum class WaitMode : uint8_t {
+    BusySpin,   // Lowest latency, burns the core
+    SpinYield,  // Spin for a bounded number of polls, then yield the CPU between polls
+    Park,       // Spin briefly, then sleep on a futex until a producer calls notify()
+};
+
+// Idle policy for worker loops. The consumer calls idle() after a poll found nothing and reset()
+// after it found work; producers call notify() after publishing. notify() only costs an atomic
+// when the consumer is parked-capable, and only makes a syscall when someone is actually asleep.
+class WaitStrategy {
+private:
+    WaitMode mode_;
+    uint32_t spin_limit_;
+    uint32_t spins_ = 0;
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> epoch_{0};
+    std::atomic<uint32_t> sleepers_{0};
+
+public:
+    explicit WaitStrategy(WaitMode mode = WaitMode::BusySpin, uint32_t spin_limit = 10000)
+        : mode_(mode), spin_limit_(spin_limit) {}
+
+    WaitStrategy(const WaitStrategy&) = delete;
+    WaitStrategy& operator=(const WaitStrategy&) = delete;
+
+    WaitMode mode() const { return mode_; }
+
+    void reset() { spins_ = 0; }
+
+    // has_work is re-checked after announcing the sleep, so a notify() racing with parking is
+    // never lost. It should also return true once the owner is stopping.
+    template<typename Ready>
+    void idle(Ready&& has_work) {
+        if (mode_ == WaitMode::BusySpin || ++spins_ < spin_limit_) {
+            cpu_relax();
+            return;
+        }
+        if (mode_ == WaitMode::SpinYield) {
+            std::this_thread::yield();
+            return;
+        }
+        uint32_t epoch = epoch_.load(std::memory_order_acquire);
+        sleepers_.fetch_add(1, std::memory_order_seq_cst);
+        if (!has_work()) {
+            epoch_.wait(epoch, std::memory_order_acquire);
+        }
+        sleepers_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void notify() {
+        if (mode_ != WaitMode::Park) {
+            return;
+        }
+        // An RMW rather than a load: it reads the latest sleeper count, pairing with the
+        // consumer's increment so either we see the sleeper or it sees our published work
+        if (sleepers_.fetch_add(0, std::memory_order_seq_cst) != 0) {
+            epoch_.fetch_add(1, std::memory_order_release);
+            epoch_.notify_all();
+        }
+    }
+};
+
+// Pins the calling thread to one CPU; negative means leave it unpinned
+inline bool pin_current_thread(int cpu, const char* name = nullptr) {
+    if (name) {
+        pthread_setname_np(pthread_self(), name);
+    }
+    if (cpu < 0) {
+        return true;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+// Parses a kernel-style CPU list ("2-5,8"), e.g. the isolcpus= set reserved for trading threads
+inline std::vector<int> parse_cpu_list(const std::string& list) {
+    std::vector<int> cpus;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos) end = list.size();
+        std::string item = list.substr(pos, end - pos);
+        size_t dash = item.find('-');
+        if (!item.empty()) {
+            int first = std::stoi(item.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(item.substr(dash + 1));
+            for (int cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(cpu);
+            }
+        }
+        pos = end + 1;
+    }
+    return cpus;
+}
+
+// Asynchronous binary logging
+// Hot threads never format or write. A log call copies a format id and raw argument words into a
+// fixed-size record on the calling thread's own ring; a background thread formats the records and
+// writes them to a file. A full ring drops the record and counts it instead of blocking.
+// Journal records travel the same rings but are handed unformatted to an attached journal sink,
+// and are never dropped: a full ring makes the producer wait for the writer.
+enum class LogFormat : uint16_t {
+    SystemStarted,
+    SystemStopped,
+    OrderProcessed,
+    MakerSymbolConfigured,
+    MakerOrderRejected,
+    RiskLimitsSet,
+    RiskOrderRejected,
+    PositionUpdated,
+    OrderCancelled,
+    OrderModified,
+    OrderRequestRejected,
+    OrderOverfilled,
+    FeedGap,
+    BookRecentered,
+    BookOutOfWindow,
+    ControlRejected,
+    JournalSnapshotFailed,
+    // Journal records: routed to the attached journal sink instead of the text log
+    JournalOrderOpened,
+    JournalOrderAmended,
+    JournalFill,
+    JournalOrderClosed,
+    COUNT
+};
+
+inline bool is_journal_format(LogFormat format) {
+    return format >= LogFormat::JournalOrderOpened && format <= LogFormat::JournalOrderClosed;
+}
+
+// Placeholders are {} and are filled in argument order
+inline const char* log_format_string(LogFormat format) {
+    static constexpr const char* FORMATS[] = {
+        "trading system started: shards={} strategies={}",
+        "trading system stopped",
+        "order processed: id={} symbol={} side={} price={} qty={}",
+        "maker configured: symbol={} spread={} levels={}",
+        "maker order not sent: symbol={} side={} price={} status={}",
+        "risk limits set: symbol={}",
+        "risk reject: id={} symbol={} reason={}",
+        "position update: symbol={} position={} vwap={}",
+        "order cancelled: id={} symbol={} remaining={}",
+        "order modified: id={} symbol={} price={} qty={}",
+        "order request rejected: id={} reason={}",
+        "order overfilled: id={} symbol={} filled={} qty={}",
+        "feed gap: line={} expected={} resumed={} lost={}",
+        "book recentered: symbol={} window_base={}",
+        "book update outside window: symbol={} bid={} ask={}",
+        "control command rejected: {}",
+        "journal snapshot failed: {}",
+        "journal order opened: id={} symbol={} buy={} price={} qty={}",
+        "journal order amended: id={} symbol={} price={} qty={}",
+        "journal fill: id={} symbol={} buy={} price={} qty={}",
+        "journal order closed: id={} symbol={}",
+    };
+    return FORMATS[static_cast<size_t>(format)];
+}
+
+// Logged as the ticker rather than the numeric id
+struct LogSymbol {
+    SymbolId id;
+};
+
+struct LogRecord {
+    static constexpr size_t MAX_ARGS = 6;
+
+    enum class ArgType : uint8_t { Int, Uint, Double, Bool, String, Symbol };
+
+    int64_t timestamp_ns;
+    LogFormat format;
+    uint8_t arg_count;
+    ArgType types[MAX_ARGS];
+    uint64_t args[MAX_ARGS];
+};
+
+static_assert(std::is_trivially_copyable_v<LogRecord>, "LogRecord must be trivially copyable");
+
+namespace log_detail {
+
+template<typename T>
+inline void encode(LogRecord& record, const T& value) {
+    size_t i = record.arg_count++;
+    if constexpr (std::is_same_v<T, LogSymbol>) {
+        record.types[i] = LogRecord::ArgType::Symbol;
+        record.args[i] = value.id;
+    } else if constexpr (std::is_same_v<T, bool>) {
+        record.types[i] = LogRecord::ArgType::Bool;
+        record.args[i] = value;
+    } else if constexpr (std::is_enum_v<T>) {
+        record.types[i] = LogRecord::ArgType::Uint;
+        record.args[i] = static_cast<uint64_t>(value);
+    } else if constexpr (std::is_floating_point_v<T>) {
+        double d = static_cast<double>(value);
+        record.types[i] = LogRecord::ArgType::Double;
+        std::memcpy(&record.args[i], &d, sizeof(d));
+    } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+        record.types[i] = LogRecord::ArgType::Int;
+        record.args[i] = static_cast<uint64_t>(static_cast<int64_t>(value));
+    } else if constexpr (std::is_integral_v<T>) {
+        record.types[i] = LogRecord::ArgType::Uint;
+        record.args[i] = static_cast<uint64_t>(value);
+    } else {
+        // Only the pointer is copied, so strings must outlive the logger (use literals)
+        static_assert(std::is_convertible_v<T, const char*>, "Unsupported log argument type");
+        record.types[i] = LogRecord::ArgType::String;
+        record.args[i] = reinterpret_cast<uintptr_t>(static_cast<const char*>(value));
+    }
+}
+
+}  // namespace log_detail
+
+class AsyncLogger {
+private:
+    static constexpr size_t RING_SIZE = 4096;
+    static constexpr size_t MAX_THREADS = 256;
+
+    struct ThreadRing {
+        LockFreeQueue<LogRecord, RING_SIZE> records;
+        std::atomic<uint64_t> dropped{0};
+    };
+
+    // Type-erased at attach time; called on the writer thread for every journal record
+    struct JournalSink {
+        void* sink = nullptr;
+        void (*write)(void* sink, const LogRecord& record) = nullptr;
+    };
+
+    std::mutex mutex_;  // Guards thread registration and start/stop only
+    std::mutex drain_mutex_;  // Held for each drain pass, so the journal sink can be swapped safely
+    JournalSink journal_;
+    std::atomic<bool> journal_enabled_{false};
+    std::atomic<uint64_t> journal_dropped_{0};
+    std::vector<std::unique_ptr<ThreadRing>> rings_;
+    ThreadRing* ring_slots_[MAX_THREADS] = {};  // Read by the writer thread without the mutex
+    std::atomic<size_t> ring_count_{0};
+    std::atomic<uint64_t> overflow_dropped_{0};  // Threads beyond MAX_THREADS cannot log
+    int64_t wall_offset_ns_ = 0;  // Converts LatencyClock stamps to wall-clock time
+    std::atomic<bool> enabled_{false};
+    std::atomic<bool> running_{false};
+    std::thread writer_thread_;
+    std::FILE* file_ = nullptr;
+
+    ThreadRing* register_thread() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t count = ring_count_.load(std::memory_order_relaxed);
+        if (count == MAX_THREADS) {
+            return nullptr;
+        }
+        rings_.push_back(std::make_unique<ThreadRing>());
+        ring_slots_[count] = rings_.back().get();
+        ring_count_.store(count + 1, std::memory_order_release);
+        return ring_slots_[count];
+    }
+
+    ThreadRing* local_ring() {
+        thread_local ThreadRing* ring = register_thread();
+        return ring;
+    }
+
+    void write_record(const LogRecord& record) {
+        char line[512];
+        int64_t wall_ns = record.timestamp_ns + wall_offset_ns_;
+        int len = std::snprintf(line, sizeof(line), "%lld.%09lld ",
+                                static_cast<long long>(wall_ns / 1000000000),
+                                static_cast<long long>(wall_ns % 1000000000));
+        size_t pos = len > 0 ? static_cast<size_t>(len) : 0;
+        size_t arg = 0;
+        for (const char* p = log_format_string(record.format); *p && pos < sizeof(line) - 1; ++p) {
+            if (p[0] == '{' && p[1] == '}' && arg < record.arg_count) {
+                pos += format_arg(line + pos, sizeof(line) - pos, record, arg++);
+                ++p;
+            } else {
+                line[pos++] = *p;
+            }
+        }
+        pos = std::min(pos, sizeof(line) - 1);
+        line[pos++] = '\n';
+        std::fwrite(line, 1, pos, file_);
+    }
+
+    static size_t format_arg(char* out, size_t size, const LogRecord& record, size_t i) {
+        uint64_t raw = record.args[i];
+        int n = 0;
+        switch (record.types[i]) {
+            case LogRecord::ArgType::Int:
+                n = std::snprintf(out, size, "%lld", static_cast<long long>(raw));
+                break;
+            case LogRecord::ArgType::Uint:
+                n = std::snprintf(out, size, "%llu", static_cast<unsigned long long>(raw));
+                break;
+            case LogRecord::ArgType::Double: {
+                double d;
+                std::memcpy(&d, &raw, sizeof(d));
+                n = std::snprintf(out, size, "%.6g", d);
+                break;
+            }
+            case LogRecord::ArgType::Bool:
+                n = std::snprintf(out, size, "%s", raw ? "true" : "false");
+                break;
+            case LogRecord::ArgType::String:
+                n = std::snprintf(out, size, "%s", reinterpret_cast<const char*>(raw));
+                break;
+            case LogRecord::ArgType::Symbol:
+                n = raw < symbols().size()
+                    ? std::snprintf(out, size, "%s", symbols().name(static_cast<SymbolId>(raw)).c_str())
+                    : std::snprintf(out, size, "#%llu", static_cast<unsigned long long>(raw));
+                break;
+        }
+        return n > 0 ? std::min(static_cast<size_t>(n), size - 1) : 0;
+    }
+
+    // Drains every ring once; returns the number of records written
+    size_t drain() {
+        size_t written = 0;
+        size_t count = ring_count_.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count; ++i) {
+            written += ring_slots_[i]->records.consume_n([this](LogRecord& record) {
+                if (!is_journal_format(record.format)) {
+                    write_record(record);
+                } else if (journal_.write) {
+                    journal_.write(journal_.sink, record);
+                }
+            }, RING_SIZE);
+        }
+        return written;
+    }
+
+public:
+    static AsyncLogger& instance();
+
+    ~AsyncLogger() {
+        stop();
+    }
+
+    bool start(const std::string& path) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (running_) {
+            return true;
+        }
+        file_ = std::fopen(path.c_str(), "a");
+        if (!file_) {
+            return false;
+        }
+        std::setvbuf(file_, nullptr, _IOFBF, 1 << 20);
+        wall_offset_ns_ = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count() - LatencyClock::now_ns();
+        running_ = true;
+        enabled_.store(true, std::memory_order_release);
+        writer_thread_ = std::thread([this]() {
+            pin_current_thread(-1, "async-logger");
+            while (running_.load(std::memory_order_acquire)) {
+                size_t written;
+                {
+                    std::lock_guard<std::mutex> drain_lock(drain_mutex_);
+                    written = drain();
+                }
+                if (written) {
+                    std::fflush(file_);
+                } else {
+                    std::this_thread::sleep_for(std::chrono::microseconds(100));
+                }
+            }
+        });
+        return true;
+    }
+
+    void stop() {
+        enabled_.store(false, std::memory_order_release);
+        running_.store(false, std::memory_order_release);
+        if (writer_thread_.joinable()) {
+            writer_thread_.join();
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (file_) {
+            {
+                std::lock_guard<std::mutex> drain_lock(drain_mutex_);
+                while (drain()) {}
+            }
+            uint64_t dropped = overflow_dropped_.load(std::memory_order_relaxed);
+            for (const auto& ring : rings_) {
+                dropped += ring->dropped.load(std::memory_order_relaxed);
+            }
+            if (dropped) {
+                std::fprintf(file_, "logger dropped %llu records\n",
+                             static_cast<unsigned long long>(dropped));
+            }
+            std::fclose(file_);
+            file_ = nullptr;
+        }
+    }
+
+    template<typename... Args>
+    void log(LogFormat format, const Args&... args) {
+        static_assert(sizeof...(Args) <= LogRecord::MAX_ARGS, "Too many log arguments");
+        if (!enabled_.load(std::memory_order_relaxed)) {
+            return;
+        }
+        ThreadRing* ring = local_ring();
+        if (!ring) {
+            overflow_dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        LogRecord record;
+        record.timestamp_ns = LatencyClock::now_ns();
+        record.format = format;
+        record.arg_count = 0;
+        (log_detail::encode(record, args), ...);
+        if (!ring->records.push(record)) {
+            ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Like log() for journal formats, but waits out a full ring. Records are lost only if the
+    // logger stops first or the thread has no ring; both are counted in journal_dropped().
+    template<typename... Args>
+    void journal(LogFormat format, const Args&... args) {
+        static_assert(sizeof...(Args) <= LogRecord::MAX_ARGS, "Too many log arguments");
+        if (!journal_enabled_.load(std::memory_order_relaxed)) {
+            return;
+        }
+        ThreadRing* ring = local_ring();
+        if (!ring) {
+            journal_dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        LogRecord record;
+        record.timestamp_ns = LatencyClock::now_ns();
+        record.format = format;
+        record.arg_count = 0;
+        (log_detail::encode(record, args), ...);
+        while (running_.load(std::memory_order_acquire)) {
+            if (ring->records.push(record)) {
+                return;
+            }
+            cpu_relax();
+        }
+        journal_dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Sink needs a static void write(void* sink, const LogRecord&). The logger must be running.
+    template<typename Sink>
+    bool attach_journal(Sink& sink) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) {
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> drain_lock(drain_mutex_);
+            journal_ = JournalSink{&sink, &Sink::write};
+        }
+        journal_enabled_.store(true, std::memory_order_release);
+        return true;
+    }
+
+    // Hands every journal record already queued to the sink, then detaches it. Journaling threads
+    // must have stopped, or their later records are dropped; stop() drains the rings itself.
+    void detach_journal() {
+        journal_enabled_.store(false, std::memory_order_release);
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::lock_guard<std::mutex> drain_lock(drain_mutex_);
+        if (journal_.write && file_) {
+            while (drain()) {}
+        }
+        journal_ = JournalSink{};
+    }
+
+    uint64_t journal_dropped() const {
+        return journal_dropped_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t dropped() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t total = overflow_dropped_.load(std::memory_order_relaxed);
+        for (const auto& ring : rings_) {
+            total += ring->dropped.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+};
+
+template<typename... Args>
+inline void log_event(LogFormat format, const Args&... args) {
+    AsyncLogger::instance().log(format, args...);
+}
+
+template<typename... Args>
+inline void journal_event(LogFormat format, const Args&... args) {
+    AsyncLogger::instance().journal(format, args...);
+}
+
+// Read-copy-update for configuration
+// Config lives in immutable heap snapshots. A writer publishes a new snapshot with one atomic
+// exchange and retires the old one; readers take the current snapshot with one acquire load and
+// never write shared state. Retired snapshots are freed once every online reader thread has
+// passed a quiescent point (QSBR). Worker loops call RcuDomain::quiescent() between events, which
+// is one load and one store to the thread's own cache line. Any other thread that dereferences a
+// snapshot does so inside an RcuReadScope. A reader parked in its loop stays online and only
+// delays reclamation.
+class RcuDomain {
+private:
+    static constexpr size_t MAX_READERS = 256;
+
+    struct alignas(CACHE_LINE_SIZE) Reader {
+        std::atomic<uint64_t> seen{0};  // Epoch at the last quiescent point; 0 while offline
+        std::atomic<bool> claimed{false};
+    };
+
+    struct Retired {
+        uint64_t epoch;
+        const void* snapshot;
+        void (*destroy)(const void* snapshot);
+    };
+
+    // Releases the thread's reader slot when it exits
+    struct ThreadState {
+        Reader* reader = nullptr;
+        bool online = false;
+
+        ~ThreadState() {
+            if (reader) {
+                reader->seen.store(0, std::memory_order_release);
+                reader->claimed.store(false, std::memory_order_release);
+            }
+        }
+    };
+
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> epoch_{1};
+    Reader readers_[MAX_READERS];
+    std::mutex mutex_;  // Writers and reclaim only
+    std::vector<Retired> retired_;
+
+    static ThreadState& thread_state() {
+        thread_local ThreadState state;
+        return state;
+    }
+
+    Reader* claim_reader() {
+        for (Reader& reader : readers_) {
+            bool expected = false;
+            if (!reader.claimed.load(std::memory_order_relaxed) &&
+                reader.claimed.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+                return &reader;
+            }
+        }
+        throw std::runtime_error("RCU reader slots exhausted");
+    }
+
+public:
+    // Defined in common.cpp
+    static RcuDomain& instance();
+
+    ~RcuDomain() {
+        for (const Retired& retired : retired_) {
+            retired.destroy(retired.snapshot);
+        }
+    }
+
+    // The calling thread holds no snapshot from before this point; registers it on first use
+    static void quiescent() {
+        ThreadState& state = thread_state();
+        if (state.online) {
+            state.reader->seen.store(instance().epoch_.load(std::memory_order_acquire), std::memory_order_release);
+            return;
+        }
+        if (!state.reader) {
+            state.reader = instance().claim_reader();
+        }
+        // An RMW, paired with reclaim's: either reclaim sees this thread online, or this thread
+        // synchronizes with that reclaim and its next load sees every snapshot published before it
+        state.reader->seen.exchange(instance().epoch_.load(std::memory_order_acquire), std::memory_order_acq_rel);
+        state.online = true;
+    }
+
+    // The calling thread holds no snapshots and will not read any until its next quiescent()
+    static void offline() {
+        ThreadState& state = thread_state();
+        if (state.online) {
+            state.reader->seen.store(0, std::memory_order_release);
+            state.online = false;
+        }
+    }
+
+    static bool online() {
+        return thread_state().online;
+    }
+
+    // Called after the snapshot has been unpublished
+    void retire(const void* snapshot, void (*destroy)(const void*)) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t epoch = epoch_.fetch_add(1, std::memory_order_seq_cst) + 1;
+        retired_.push_back(Retired{epoch, snapshot, destroy});
+    }
+
+    // Frees every retired snapshot no online reader can still hold; returns how many
+    size_t reclaim() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t safe = ~uint64_t{0};
+        for (Reader& reader : readers_) {
+            uint64_t seen = reader.seen.fetch_add(0, std::memory_order_acq_rel);
+            if (seen != 0 && seen < safe) {
+                safe = seen;
+            }
+        }
+        auto keep = std::partition(retired_.begin(), retired_.end(),
+                                   [safe](const Retired& retired) { return retired.epoch > safe; });
+        for (auto it = keep; it != retired_.end(); ++it) {
+            it->destroy(it->snapshot);
+        }
+        size_t freed = static_cast<size_t>(retired_.end() - keep);
+        retired_.erase(keep, retired_.end());
+        return freed;
+    }
+
+    size_t retired() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return retired_.size();
+    }
+};
+
+// Brings a thread outside a worker loop online for the scope; a no-op on threads already online
+class RcuReadScope {
+private:
+    bool entered_;
+
+public:
+    RcuReadScope() : entered_(!RcuDomain::online()) {
+        if (entered_) {
+            RcuDomain::quiescent();
+        }
+    }
+
+    ~RcuReadScope() {
+        if (entered_) {
+            RcuDomain::offline();
+        }
+    }
+
+    RcuReadScope(const RcuReadScope&) = delete;
+    RcuReadScope& operator=(const RcuReadScope&) = delete;
+};
+
+// Current snapshot of one config value; null until the first publish
+template<typename T>
+class RcuPtr {
+private:
+    std::atomic<const T*> current_{nullptr};
+
+public:
+    RcuPtr() = default;
+    RcuPtr(const RcuPtr&) = delete;
+    RcuPtr& operator=(const RcuPtr&) = delete;
+
+    ~RcuPtr() {
+        delete current_.load(std::memory_order_relaxed);
+    }
+
+    // Valid until the reading thread's next quiescent point
+    const T* load() const {
+        return current_.load(std::memory_order_acquire);
+    }
+
+    // load() as a read-modify-write: the caller's earlier atomic writes are ordered before any
+    // later publish, and any earlier publish is seen. For re-checking after acting on a snapshot.
+    const T* load_ordered() {
+        const T* expected = current_.load(std::memory_order_relaxed);
+        while (!current_.compare_exchange_weak(expected, expected, std::memory_order_acq_rel)) {}
+        return expected;
+    }
+
+    // Replaces the snapshot; the previous one is freed once no reader can still hold it
+    void publish(std::unique_ptr<const T> next) {
+        const T* previous = current_.exchange(next.release(), std::memory_order_seq_cst);
+        if (previous) {
+            RcuDomain::instance().retire(previous, [](const void* snapshot) {
+                delete static_cast<const T*>(snapshot);
+            });
+        }
+    }
+};
+
+// Market data events as they travel through shard rings and strategy inboxes
+struct MarketEvent {
+    enum class Type : uint8_t {
+        Quote,
+        Trade,
+        BookUpdate,  // Top-of-book changed after applying a quote
+    };
+
+    Type type;
+    SymbolId symbol;
+    int64_t enqueue_ns = 0;  // LatencyClock stamp taken when the event entered a ring
+    union {
+        Quote quote;
+        Trade trade;
+        TopOfBook top;
+    };
+
+    explicit MarketEvent(const Quote& q) : type(Type::Quote), symbol(q.symbol), quote(q) {}
+    explicit MarketEvent(const Trade& t) : type(Type::Trade), symbol(t.symbol), trade(t) {}
+    MarketEvent(SymbolId s, const TopOfBook& t) : type(Type::BookUpdate), symbol(s), top(t) {}
+};
+
+static_assert(std::is_trivially_copyable_v<MarketEvent>, "MarketEvent must be trivially copyable");
+
+// Calls the matching handler on a subscriber; resolved at compile time for each subscriber type
+template<typename Subscriber>
+inline void dispatch_market_event(Subscriber& subscriber, const MarketEvent& event) {
+    switch (event.type) {
+        case MarketEvent::Type::Quote:
+            subscriber.on_quote(event.quote);
+            break;
+        case MarketEvent::Type::Trade:
+            subscriber.on_trade(event.trade);
+            break;
+        case MarketEvent::Type::BookUpdate:
+            subscriber.on_book_update(event.symbol, event.top);
+            break;
+    }
+}
+
+struct MarketDataConfig {
+    size_t num_shards = 1;
+    std::vector<int> shard_cpus;  // CPU for shard i; missing entries run unpinned
+    WaitMode wait_mode = WaitMode::BusySpin;
+    // Each book's node slab is mapped and populated up front, so size these to the universe:
+    // an L1/L2-only feed needs few order nodes
+    size_t book_levels = 4096;
+    size_t max_orders_per_symbol = 65536;
+    bool book_huge_pages = false;
+};
+
+// Market data handler
+// Symbols are split across shards. Each shard owns its books, its own input ring and one thread,
+// so no book is ever touched by two threads. Events are routed by a fixed symbol->shard table,
+// applied to the book, then handed to the symbol's subscribers on the shard thread.
+class MarketDataHandler {
+private:
+    static constexpr size_t EVENT_BATCH = 64;
+
+    // Type-erased only at registration: each thunk is instantiated for its subscriber type, so
+    // the handler calls inside it are direct
+    struct Listener {
+        void* subscriber;
+        void (*dispatch)(void* subscriber, const MarketEvent& event);
+    };
+
+    struct Shard {
+        explicit Shard(WaitMode mode) : waiter(mode) {}
+
+        LockFreeQueue<MarketEvent, 8192> event_queue;
+        WaitStrategy waiter;
+        std::vector<SymbolId> symbols;
+        std::thread thread;
+        int cpu = -1;
+        alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> updates{0};  // Events applied
+        QueueGauge queue_gauge{decltype(event_queue)::capacity()};
+    };
+
+    MarketDataConfig config_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::vector<uint32_t> shard_of_ = std::vector<uint32_t>(MAX_SYMBOLS, 0);
+    std::vector<std::unique_ptr<OrderBook>> order_books_{MAX_SYMBOLS};  // Indexed by SymbolId
+    std::vector<std::vector<Listener>> listeners_{MAX_SYMBOLS};
+    std::atomic<bool> running_{true};
+
+public:
+    explicit MarketDataHandler(const MarketDataConfig& config = {}) : config_(config) {
+        if (config_.book_levels == 0) {
+            throw std::invalid_argument("MarketDataConfig::book_levels must be positive");
+        }
+        size_t count = std::max<size_t>(1, config.num_shards);
+        for (size_t i = 0; i < count; ++i) {
+            shards_.push_back(std::make_unique<Shard>(config.wait_mode));
+            shards_[i]->cpu = i < config.shard_cpus.size() ? config.shard_cpus[i] : -1;
+            MetricsRegistry::instance().add_queue(
+                this, "queue=\"market_data\",shard=\"" + std::to_string(i) + "\"", shards_[i]->queue_gauge);
+        }
+    }
+
+    ~MarketDataHandler() {
+        MetricsRegistry::instance().remove_gauges(this);
+    }
+
+    void start() {
+        for (size_t i = 0; i < shards_.size(); ++i) {
+            shards_[i]->thread = std::thread([this, i]() { run_shard(i); });
+        }
+    }
+
+    void stop() {
+        running_ = false;
+        for (auto& shard : shards_) {
+            shard->waiter.notify();
+            if (shard->thread.joinable()) {
+                shard->thread.join();
+            }
+        }
+    }
+
+    // Each shard ring is single-producer: one feed thread per shard (or one overall) may call
+    // these. They return false if the owning shard has fallen a full ring behind.
+    [[nodiscard]] bool on_quote(const Quote& quote) {
+        return route(MarketEvent(quote));
+    }
+
+    [[nodiscard]] bool on_trade(const Trade& trade) {
+        return route(MarketEvent(trade));
+    }
+
+    // Books must be registered before start(), the owning shard thread owns them afterwards.
+    // Symbols are dealt round-robin by id unless a shard is given explicitly. max_orders
+    // overrides the configured L3 capacity for this symbol's book when non-zero.
+    OrderBook& add_symbol(SymbolId symbol, Price anchor_price = 0, int shard = -1, size_t max_orders = 0) {
+        auto& book = order_books_[symbol];
+        if (!book) {
+            book = std::make_unique<OrderBook>(symbol, config_.book_levels,
+                                               max_orders ? max_orders : config_.max_orders_per_symbol,
+                                               anchor_price, config_.book_huge_pages);
+            size_t index = shard >= 0 ? static_cast<size_t>(shard) % shards_.size()
+                                      : symbol % shards_.size();
+            shard_of_[symbol] = static_cast<uint32_t>(index);
+            shards_[index]->symbols.push_back(symbol);
+            std::string label = "symbol=\"" + metric_symbol_label(symbol) + "\"";
+            MetricsRegistry& metrics = MetricsRegistry::instance();
+            metrics.add_pool(this, "pool=\"book_orders\"," + label, book->node_pool());
+            metrics.add_gauge(this, "book_recenters_total", label, book.get(), [](const void* b) {
+                return static_cast<double>(static_cast<const OrderBook*>(b)->recenters());
+            });
+            metrics.add_gauge(this, "book_out_of_window_total", label, book.get(), [](const void* b) {
+                return static_cast<double>(static_cast<const OrderBook*>(b)->out_of_window());
+            });
+        }
+        return *book;
+    }
+
+    // Registers for on_quote/on_trade/on_book_update callbacks for one symbol; before start().
+    // Callbacks run inline on the shard thread that owns the symbol, so they must not block.
+    template<typename Subscriber>
+    void subscribe(SymbolId symbol, Subscriber& subscriber) {
+        listeners_[symbol].push_back(Listener{&subscriber, [](void* self, const MarketEvent& event) {
+            dispatch_market_event(*static_cast<Subscriber*>(self), event);
+        }});
+    }
+
+    const OrderBook* find_book(SymbolId symbol) const {
+        return symbol < MAX_SYMBOLS ? order_books_[symbol].get() : nullptr;
+    }
+
+    size_t shard_count() const { return shards_.size(); }
+    size_t shard_for(SymbolId symbol) const { return shard_of_[symbol]; }
+    int shard_cpu(size_t shard) const { return shards_[shard]->cpu; }
+    const std::vector<SymbolId>& shard_symbols(size_t shard) const { return shards_[shard]->symbols; }
+
+    // Monotonic count of events applied by a shard
+    uint64_t shard_updates(size_t shard) const {
+        return shards_[shard]->updates.load(std::memory_order_acquire);
+    }
+
+private:
+    bool route(MarketEvent event) {
+        if (event.symbol >= MAX_SYMBOLS) {
+            return false;
+        }
+        event.enqueue_ns = LatencyClock::now_ns();
+        Shard& shard = *shards_[shard_of_[event.symbol]];
+        if (!shard.event_queue.push(event)) {
+            count_metric(Metric::MarketDataQueueFull);
+            return false;
+        }
+        shard.waiter.notify();
+        return true;
+    }
+
+    void run_shard(size_t index) {
+        Shard& shard = *shards_[index];
+        std::string name = "md-shard-" + std::to_string(index);
+        pin_current_thread(shard.cpu, name.c_str());
+        while (running_) {
+            RcuDomain::quiescent();  // Subscribers read config snapshots
+            size_t n = shard.event_queue.consume_n(
+                [this](MarketEvent& event) { process_event(event); }, EVENT_BATCH);
+            if (n) {
+                shard.updates.fetch_add(n, std::memory_order_release);
+                shard.queue_gauge.observe(n + shard.event_queue.size());  // Depth when the batch started
+                shard.waiter.reset();
+            } else {
+                shard.queue_gauge.observe(0);
+                shard.waiter.idle([&shard, this] { return !shard.event_queue.empty() || !running_; });
+            }
+        }
+    }
+
+    void process_event(const MarketEvent& event) {
+        OrderBook* book = order_books_[event.symbol].get();
+        const auto& listeners = listeners_[event.symbol];
+        if (event.type == MarketEvent::Type::Quote && book) {
+            int64_t start = LatencyClock::now_ns();
+            record_latency(LatencyStage::QuoteQueue, start - event.enqueue_ns);
+            uint64_t sequence = book->top_of_book().sequence;
+            uint64_t recenters = book->recenters();
+            if (!book->update(event.quote)) {
+                log_event(LogFormat::BookOutOfWindow, LogSymbol{event.symbol}, event.quote.bid, event.quote.ask);
+            } else if (book->recenters() != recenters) {
+                log_event(LogFormat::BookRecentered, LogSymbol{event.symbol}, book->window_base());
+            }
+            record_latency(LatencyStage::BookUpdate, LatencyClock::now_ns() - start);
+            notify(listeners, event);
+            TopOfBook top = book->top_of_book();
+            if (top.sequence != sequence) {
+                notify(listeners, MarketEvent(event.symbol, top));
+            }
+            return;
+        }
+        notify(listeners, event);
+    }
+
+    static void notify(const std::vector<Listener>& listeners, const MarketEvent& event) {
+        for (const Listener& listener : listeners) {
+            listener.dispatch(listener.subscriber, event);
+        }
+    }
+};
+
+// Tick journal
+// Capture format: a 64-byte header, a fixed-size symbol dictionary, then 48-byte records.
+// Records carry file-local symbol indices, so captures from different processes can be replayed
+// together; the reader maps dictionary names to local ids.
+struct TickFileHeader {
+    static constexpr uint64_t MAGIC = 0x4C4E524A4B434954ull;  // "TICKJRNL"
+    static constexpr uint32_t VERSION = 1;
+
+    uint64_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t max_symbols;   // Dictionary capacity
+    uint32_t symbol_count;
+    uint64_t record_count;  // Committed records, published with release ordering
+    uint64_t capacity;      // Records the file is sized for
+    uint8_t reserved[24];
+};
+
+struct TickFileSymbol {
+    char name[24];
+    double tick_size;
+};
+
+struct TickRecord {
+    enum Type : uint8_t { QuoteTick, TradeTick };
+
+    int64_t timestamp_ns;
+    uint32_t symbol;  // Index into the file's dictionary
+    uint8_t type;
+    uint8_t is_buy;   // Trades only
+    uint16_t reserved;
+    Price price_a;    // Bid, or trade price
+    Price price_b;    // Ask
+    uint64_t size_a;  // Bid size, or trade quantity
+    uint64_t size_b;  // Ask size
+};
+
+static_assert(sizeof(TickFileHeader) == 64, "TickFileHeader layout is part of the file format");
+static_assert(sizeof(TickFileSymbol) == 32, "TickFileSymbol layout is part of the file format");
+static_assert(sizeof(TickRecord) == 48, "TickRecord layout is part of the file format");
+
+inline size_t tick_records_offset(uint32_t max_symbols) {
+    size_t bytes = sizeof(TickFileHeader) + size_t{max_symbols} * sizeof(TickFileSymbol);
+    return (bytes + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+}
+
+// Single-producer writer into a pre-sized, memory-mapped journal. Records are filled in place
+// (claim/commit), so capture costs one record write and a release store per tick.
+class TickJournalWriter {
+private:
+    static constexpr uint32_t UNMAPPED = ~uint32_t{0};
+
+    int fd_ = -1;
+    unsigned char* base_ = nullptr;
+    size_t mapped_bytes_ = 0;
+    TickFileHeader* header_ = nullptr;
+    TickFileSymbol* dictionary_ = nullptr;
+    TickRecord* records_ = nullptr;
+    uint64_t count_ = 0;
+    uint64_t dropped_ = 0;
+    std::vector<uint32_t> file_symbol_ = std::vector<uint32_t>(MAX_SYMBOLS, UNMAPPED);
+
+    // Dictionary index for a process symbol id, added on first use
+    uint32_t file_symbol(SymbolId symbol) {
+        uint32_t& index = file_symbol_[symbol];
+        if (index == UNMAPPED && header_->symbol_count < header_->max_symbols) {
+            index = header_->symbol_count;
+            TickFileSymbol& entry = dictionary_[index];
+            std::strncpy(entry.name, symbols().name(symbol).c_str(), sizeof(entry.name) - 1);
+            entry.tick_size = symbols().tick_size(symbol);
+            header_->symbol_count = index + 1;
+        }
+        return index;
+    }
+
+public:
+    TickJournalWriter(const std::string& path, uint64_t capacity, uint32_t max_symbols = 1024) {
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0) {
+            throw std::runtime_error("Cannot create tick journal " + path + ": " + std::strerror(errno));
+        }
+        mapped_bytes_ = tick_records_offset(max_symbols) + capacity * sizeof(TickRecord);
+        if (::ftruncate(fd_, static_cast<off_t>(mapped_bytes_)) != 0) {
+            ::close(fd_);
+            throw std::runtime_error("Cannot size tick journal " + path + ": " + std::strerror(errno));
+        }
+        void* mem = mmap(nullptr, mapped_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (mem == MAP_FAILED) {
+            ::close(fd_);
+            throw std::runtime_error("Cannot map tick journal " + path + ": " + std::strerror(errno));
+        }
+        base_ = static_cast<unsigned char*>(mem);
+        header_ = reinterpret_cast<TickFileHeader*>(base_);
+        dictionary_ = reinterpret_cast<TickFileSymbol*>(base_ + sizeof(TickFileHeader));
+        records_ = reinterpret_cast<TickRecord*>(base_ + tick_records_offset(max_symbols));
+        *header_ = TickFileHeader{TickFileHeader::MAGIC, TickFileHeader::VERSION,
+                                  sizeof(TickRecord), max_symbols, 0, 0, capacity, {}};
+    }
+
+    TickJournalWriter(const TickJournalWriter&) = delete;
+    TickJournalWriter& operator=(const TickJournalWriter&) = delete;
+
+    ~TickJournalWriter() {
+        close();
+    }
+
+    // Next record to fill in place, or nullptr when the file is full (counted as dropped)
+    TickRecord* claim() {
+        if (count_ == header_->capacity) {
+            ++dropped_;
+            return nullptr;
+        }
+        return &records_[count_];
+    }
+
+    // Publishes the record returned by the last claim()
+    void commit() {
+        std::atomic_ref<uint64_t>(header_->record_count).store(++count_, std::memory_order_release);
+    }
+
+    bool append(const Quote& quote) {
+        TickRecord* record = claim();
+        if (!record) {
+            return false;
+        }
+        *record = TickRecord{quote.timestamp.count(), file_symbol(quote.symbol), TickRecord::QuoteTick, 0, 0,
+                             quote.bid, quote.ask, quote.bid_size, quote.ask_size};
+        commit();
+        return true;
+    }
+
+    bool append(const Trade& trade) {
+        TickRecord* record = claim();
+        if (!record) {
+            return false;
+        }
+        *record = TickRecord{trade.timestamp.count(), file_symbol(trade.symbol), TickRecord::TradeTick,
+                             trade.is_buy, 0, trade.price, 0, trade.quantity, 0};
+        commit();
+        return true;
+    }
+
+    // Unmaps and trims the file to the committed records
+    void close() {
+        if (!base_) {
+            return;
+        }
+        size_t used = tick_records_offset(header_->max_symbols) + count_ * sizeof(TickRecord);
+        header_->capacity = count_;
+        munmap(base_, mapped_bytes_);
+        base_ = nullptr;
+        if (::ftruncate(fd_, static_cast<off_t>(used)) != 0) {
+            std::perror("tick journal truncate");
+        }
+        ::close(fd_);
+        fd_ = -1;
+    }
+
+    uint64_t size() const { return count_; }
+    uint64_t dropped() const { return dropped_; }
+};
+
+// Read-only view of a journal. Dictionary symbols are registered in the SymbolRegistry on open.
+class TickJournalReader {
+private:
+    unsigned char* base_ = nullptr;
+    size_t mapped_bytes_ = 0;
+    const TickRecord* records_ = nullptr;
+    uint64_t count_ = 0;
+    std::vector<SymbolId> local_symbol_;
+    std::vector<double> price_scale_;  // File tick size / local tick size; 1 when they agree
+
+public:
+    explicit TickJournalReader(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open tick journal " + path + ": " + std::strerror(errno));
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(TickFileHeader)) {
+            ::close(fd);
+            throw std::runtime_error("Truncated tick journal " + path);
+        }
+        mapped_bytes_ = static_cast<size_t>(st.st_size);
+        void* mem = mmap(nullptr, mapped_bytes_, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mem == MAP_FAILED) {
+            throw std::runtime_error("Cannot map tick journal " + path + ": " + std::strerror(errno));
+        }
+        base_ = static_cast<unsigned char*>(mem);
+        madvise(base_, mapped_bytes_, MADV_SEQUENTIAL);
+
+        auto* header = reinterpret_cast<TickFileHeader*>(base_);
+        size_t offset = tick_records_offset(header->max_symbols);
+        if (header->magic != TickFileHeader::MAGIC || header->version != TickFileHeader::VERSION ||
+            header->record_size != sizeof(TickRecord) || header->symbol_count > header->max_symbols ||
+            offset > mapped_bytes_) {
+            munmap(base_, mapped_bytes_);
+            throw std::runtime_error("Not a tick journal: " + path);
+        }
+        records_ = reinterpret_cast<const TickRecord*>(base_ + offset);
+        uint64_t committed = std::atomic_ref<uint64_t>(header->record_count).load(std::memory_order_acquire);
+        count_ = std::min<uint64_t>(committed, (mapped_bytes_ - offset) / sizeof(TickRecord));
+
+        const auto* dictionary = reinterpret_cast<const TickFileSymbol*>(base_ + sizeof(TickFileHeader));
+        for (uint32_t i = 0; i < header->symbol_count; ++i) {
+            std::string name(dictionary[i].name, strnlen(dictionary[i].name, sizeof(dictionary[i].name)));
+            SymbolId id = symbols().add(name, dictionary[i].tick_size);
+            local_symbol_.push_back(id);
+            price_scale_.push_back(dictionary[i].tick_size / symbols().tick_size(id));
+        }
+    }
+
+    TickJournalReader(const TickJournalReader&) = delete;
+    TickJournalReader& operator=(const TickJournalReader&) = delete;
+
+    ~TickJournalReader() {
+        munmap(base_, mapped_bytes_);
+    }
+
+    uint64_t size() const { return count_; }
+    const TickRecord& operator[](uint64_t index) const { return records_[index]; }
+    const std::vector<SymbolId>& local_symbols() const { return local_symbol_; }
+
+    SymbolId symbol(const TickRecord& record) const {
+        return record.symbol < local_symbol_.size() ? local_symbol_[record.symbol] : INVALID_SYMBOL;
+    }
+
+    // Rescales file ticks when the symbol was already registered with a different tick size
+    Price local_price(const TickRecord& record, Price file_ticks) const {
+        double scale = price_scale_[record.symbol];
+        return scale == 1.0 ? file_ticks : std::llround(static_cast<double>(file_ticks) * scale);
+    }
+};
+
+enum class ReplayPacing : uint8_t {
+    AsFastAsPossible,
+    WallClock,  // Recorded gaps reproduced, divided by the speed factor
+};
+
+// Replays journals (e.g. one per session) merged in timestamp order into any sink with
+// MarketDataHandler's interface: bool on_quote(const Quote&) / bool on_trade(const Trade&).
+// Ties go to the earlier file, so every run delivers the same sequence. A refused event is
+// retried, never skipped.
+class TickReplayer {
+private:
+    std::vector<std::unique_ptr<TickJournalReader>> files_;
+    uint64_t retries_ = 0;
+
+public:
+    void add_file(const std::string& path) {
+        files_.push_back(std::make_unique<TickJournalReader>(path));
+    }
+
+    uint64_t total_records() const {
+        uint64_t total = 0;
+        for (const auto& file : files_) {
+            total += file->size();
+        }
+        return total;
+    }
+
+    // Local ids of every symbol in any file, for registering books before replay
+    std::vector<SymbolId> replay_symbols() const {
+        std::vector<SymbolId> ids;
+        for (const auto& file : files_) {
+            for (SymbolId id : file->local_symbols()) {
+                if (std::find(ids.begin(), ids.end(), id) == ids.end()) {
+                    ids.push_back(id);
+                }
+            }
+        }
+        return ids;
+    }
+
+    // Events the sink refused and had to be retried
+    uint64_t retries() const { return retries_; }
+
+    template<typename Sink>
+    uint64_t replay(Sink& sink, ReplayPacing pacing = ReplayPacing::AsFastAsPossible, double speed = 1.0) {
+        std::vector<uint64_t> cursor(files_.size(), 0);
+        int64_t first_ts = 0;
+        int64_t start_ns = LatencyClock::now_ns();
+        uint64_t replayed = 0;
+        while (true) {
+            // k is the number of files, so a linear scan beats a heap
+            size_t next = files_.size();
+            int64_t next_ts = 0;
+            for (size_t f = 0; f < files_.size(); ++f) {
+                if (cursor[f] < files_[f]->size()) {
+                    int64_t ts = (*files_[f])[cursor[f]].timestamp_ns;
+                    if (next == files_.size() || ts < next_ts) {
+                        next = f;
+                        next_ts = ts;
+                    }
+                }
+            }
+            if (next == files_.size()) {
+                return replayed;
+            }
+            const TickJournalReader& file = *files_[next];
+            const TickRecord& record = file[cursor[next]++];
+
+            if (pacing == ReplayPacing::WallClock) {
+                if (replayed == 0) {
+                    first_ts = record.timestamp_ns;
+                }
+                int64_t due = start_ns + static_cast<int64_t>(static_cast<double>(record.timestamp_ns - first_ts) / speed);
+                while (LatencyClock::now_ns() < due) {
+                    cpu_relax();
+                }
+            }
+
+            SymbolId symbol = file.symbol(record);
+            if (symbol == INVALID_SYMBOL) {
+                continue;
+            }
+            if (record.type == TickRecord::QuoteTick) {
+                Quote quote;
+                quote.symbol = symbol;
+                quote.bid = file.local_price(record, record.price_a);
+                quote.ask = file.local_price(record, record.price_b);
+                quote.bid_size = record.size_a;
+                quote.ask_size = record.size_b;
+                quote.timestamp = std::chrono::nanoseconds(record.timestamp_ns);
+                while (!sink.on_quote(quote)) {
+                    ++retries_;
+                    cpu_relax();
+                }
+            } else {
+                Trade trade;
+                trade.symbol = symbol;
+                trade.price = file.local_price(record, record.price_a);
+                trade.quantity = record.size_a;
+                trade.is_buy = record.is_buy != 0;
+                trade.timestamp = std::chrono::nanoseconds(record.timestamp_ns);
+                while (!sink.on_trade(trade)) {
+                    ++retries_;
+                    cpu_relax();
+                }
+            }
+            ++replayed;
+        }
+    }
+};
+
+// Sink adapter that journals every event before forwarding it, for capturing a live session
+template<typename Sink>
+class TickCapture {
+private:
+    Sink& sink_;
+    TickJournalWriter& journal_;
+
+public:
+    TickCapture(Sink& sink, TickJournalWriter& journal) : sink_(sink), journal_(journal) {}
+
+    bool on_quote(const Quote& quote) {
+        if (!sink_.on_quote(quote)) {
+            return false;
+        }
+        journal_.append(quote);
+        return true;
+    }
+
+    bool on_trade(const Trade& trade) {
+        if (!sink_.on_trade(trade)) {
+            return false;
+        }
+        journal_.append(trade);
+        return true;
+    }
+};
+
+// Risk manager
+// Per-symbol pre-trade risk state, one cache line per symbol so checks on different symbols never
+// share a line. Checks are lock-free: an order reserves its quantity against its side's open
+// exposure, and is accepted if the worst case (every open order on that side filling) stays inside
+// the position cap. Thresholds are written only when limits or fills change, never per order.
+struct alignas(CACHE_LINE_SIZE) RiskSlot {
+    static constexpr int64_t UNLIMITED = INT64_MAX / 4;  // Headroom so sums cannot overflow
+
+    std::atomic<int64_t> position{0};    // Filled net position
+    std::atomic<int64_t> open_buy{0};    // Reserved, unfilled buy quantity
+    std::atomic<int64_t> open_sell{0};   // Reserved, unfilled sell quantity
+    std::atomic<int64_t> max_order_qty{-1};  // -1: no limits configured, every order fails
+    std::atomic<int64_t> max_position{0};    // Cap on |worst-case position|
+
+    enum class Check : uint8_t { Ok, OrderSize, Position };
+
+    Check reserve(bool is_buy, int64_t qty) {
+        return reserve(is_buy, qty, qty);
+    }
+
+    // Several orders on one side at once: largest is checked against the order size cap and
+    // total is reserved with a single RMW
+    Check reserve(bool is_buy, int64_t qty, int64_t largest) {
+        if (largest > max_order_qty.load(std::memory_order_relaxed)) {
+            return Check::OrderSize;
+        }
+        std::atomic<int64_t>& open = is_buy ? open_buy : open_sell;
+        int64_t reserved = open.fetch_add(qty, std::memory_order_acq_rel) + qty;
+        int64_t pos = position.load(std::memory_order_acquire);
+        int64_t worst = is_buy ? pos + reserved : reserved - pos;
+        if (worst <= max_position.load(std::memory_order_relaxed)) {
+            return Check::Ok;
+        }
+        open.fetch_sub(qty, std::memory_order_release);
+        return Check::Position;
+    }
+
+    // Order rejected downstream or cancelled: hand back the unfilled quantity
+    void release(bool is_buy, int64_t qty) {
+        (is_buy ? open_buy : open_sell).fetch_sub(qty, std::memory_order_release);
+    }
+
+    // Fill of a reserved order. Position moves before the reservation is dropped, so a concurrent
+    // check can transiently over-count exposure but never under-count it.
+    void commit(bool is_buy, int64_t qty) {
+        fill_unreserved(is_buy, qty);
+        release(is_buy, qty);
+    }
+
+    // Fill of an order this slot never reserved: position only
+    void fill_unreserved(bool is_buy, int64_t qty) {
+        position.fetch_add(is_buy ? qty : -qty, std::memory_order_acq_rel);
+    }
+
+    // Venue filled beyond the reservation: held without a check so the commit that follows does
+    // not eat into other orders' open quantity
+    void reserve_unchecked(bool is_buy, int64_t qty) {
+        (is_buy ? open_buy : open_sell).fetch_add(qty, std::memory_order_acq_rel);
+    }
+
+    void set_thresholds(int64_t order_qty, int64_t position_cap) {
+        max_position.store(position_cap, std::memory_order_relaxed);
+        max_order_qty.store(order_qty, std::memory_order_release);
+    }
+};
+
+// Clamp a double limit into a RiskSlot threshold
+inline int64_t to_risk_threshold(double limit) {
+    if (!(limit >= 0.0)) {
+        return 0;
+    }
+    return limit >= static_cast<double>(RiskSlot::UNLIMITED)
+        ? RiskSlot::UNLIMITED : static_cast<int64_t>(limit);
+}
+
+// Average-cost accounting of a position: vwap is the average price of what is open, and
+// realized_pnl collects the PnL of quantity that closed it. Shared by the risk managers and the
+// order journal, so a replayed position carries the same VWAP as the live one.
+struct CostBasis {
+    double position = 0.0;
+    double vwap = 0.0;
+    double realized_pnl = 0.0;
+
+    void apply(bool is_buy, double quantity, double price) {
+        if (quantity == 0.0) {
+            return;
+        }
+        double signed_qty = is_buy ? quantity : -quantity;
+        double next = position + signed_qty;
+        if (position == 0.0 || (position > 0.0) == (signed_qty > 0.0)) {
+            vwap = (vwap * position + price * signed_qty) / next;
+        } else {
+            double closed = std::min(std::abs(signed_qty), std::abs(position));
+            realized_pnl += (price - vwap) * (position > 0.0 ? closed : -closed);
+            if (next == 0.0) {
+                vwap = 0.0;
+            } else if ((next > 0.0) != (position > 0.0)) {
+                vwap = price;  // Flipped: the remainder opened at this fill
+            }
+        }
+        position = next;
+    }
+};
+
+// Largest batch the span APIs accept; results come back as a 64-bit per-order mask
+constexpr size_t MAX_ORDER_BATCH = 64;
+
+class RiskManager {
+private:
+    // Indexed by SymbolId
+    std::vector<RiskSlot> slots_ = std::vector<RiskSlot>(MAX_SYMBOLS);
+
+public:
+    // max_dollar_exposure is accepted for interface compatibility; only the position cap is enforced
+    void set_position_limit(SymbolId symbol, double max_position, double max_dollar_exposure) {
+        (void)max_dollar_exposure;
+        slots_[symbol].set_thresholds(RiskSlot::UNLIMITED, to_risk_threshold(max_position));
+    }
+
+    // Reserves the order's quantity on success; safe to call from any thread
+    bool check_order(const Order& order) {
+        if (order.symbol >= MAX_SYMBOLS) {
+            return reject(RiskReject::NoLimits);
+        }
+        RiskSlot& slot = slots_[order.symbol];
+        switch (slot.reserve(order.is_buy, static_cast<int64_t>(order.quantity))) {
+        case RiskSlot::Check::Ok:
+            return true;
+        case RiskSlot::Check::OrderSize:
+            return reject(slot.max_order_qty.load(std::memory_order_relaxed) < 0 ? RiskReject::NoLimits
+                                                                                 : RiskReject::MaxOrderSize);
+        case RiskSlot::Check::Position:
+            break;
+        }
+        return reject(RiskReject::MaxNetPosition);
+    }
+
+    // Bit i set if orders[i] passed and is now reserved; at most MAX_ORDER_BATCH orders are
+    // considered. A run of orders on the same symbol and side is reserved in one step when it fits
+    // whole, otherwise order by order.
+    uint64_t check_orders(std::span<const Order> orders) {
+        size_t n = std::min(orders.size(), MAX_ORDER_BATCH);
+        uint64_t accepted = 0;
+        for (size_t i = 0; i < n;) {
+            const Order& first = orders[i];
+            size_t end = i;
+            int64_t total = 0;
+            int64_t largest = 0;
+            while (end < n && orders[end].symbol == first.symbol && orders[end].is_buy == first.is_buy) {
+                int64_t qty = static_cast<int64_t>(orders[end].quantity);
+                total += qty;
+                largest = std::max(largest, qty);
+                ++end;
+            }
+            if (first.symbol < MAX_SYMBOLS &&
+                slots_[first.symbol].reserve(first.is_buy, total, largest) == RiskSlot::Check::Ok) {
+                accepted |= (end - i == 64 ? ~uint64_t{0} : ((uint64_t{1} << (end - i)) - 1)) << i;
+            } else {
+                for (size_t k = i; k < end; ++k) {
+                    if (check_order(orders[k])) {
+                        accepted |= uint64_t{1} << k;
+                    }
+                }
+            }
+            i = end;
+        }
+        return accepted;
+    }
+
+    // Undo a successful check_order for quantity that will never fill
+    void release(const Order& order, size_t quantity) {
+        slots_[order.symbol].release(order.is_buy, static_cast<int64_t>(quantity));
+    }
+
+    // Venue fill of an order that passed check_order
+    void on_fill(const Order& order, const Trade& fill) {
+        slots_[order.symbol].commit(order.is_buy, static_cast<int64_t>(fill.quantity));
+    }
+
+    // Quantity the venue filled beyond the order's reservation, before its on_fill
+    void reserve_overfill(const Order& order, size_t quantity) {
+        slots_[order.symbol].reserve_unchecked(order.is_buy, static_cast<int64_t>(quantity));
+    }
+
+    int64_t position(SymbolId symbol) const {
+        return slots_[symbol].position.load(std::memory_order_relaxed);
+    }
+
+    // Warm restart, before trading starts; only the net position is kept here
+    void restore_position(SymbolId symbol, const CostBasis& cost, double) {
+        slots_[symbol].position.store(std::llround(cost.position), std::memory_order_relaxed);
+    }
+
+private:
+    static bool reject(RiskReject reason) {
+        count_metric(risk_reject_metric(reason));
+        return false;
+    }
+};
+
+// Result of OrderManager::submit_order
+enum class SubmitStatus : uint8_t {
+    Accepted,
+    RiskRejected,
+    QueueFull,  // Backpressure: the order thread is behind, caller decides whether to retry
+};
+
+// Result of OrderManager::submit_orders, bit i for orders[i]. Orders in neither mask were
+// risk-accepted but found the queue full (the batch is queued all or nothing).
+struct BatchSubmitStatus {
+    uint64_t accepted = 0;
+    uint64_t risk_rejected = 0;
+};
+
+enum class OrderRequestType : uint8_t {
+    New,
+    Cancel,   // Target: order.order_id
+    Modify,   // Amend order.order_id in place to order.price / order.quantity, keeping its id
+    Replace,  // Cancel `replaces` and send order under its own id
+};
+
+// Message from any submitting thread to the order thread
+struct OrderRequest {
+    OrderRequestType type = OrderRequestType::New;
+    uint64_t replaces = 0;
+    Order order;
+};
+
+static_assert(std::is_trivially_copyable_v<OrderRequest>, "OrderRequest must be trivially copyable");
+
+// Venue response to an order, decoded by a gateway
+struct ExecutionReport {
+    enum class Kind : uint8_t {
+        New,
+        Fill,            // Partial or full; last_quantity at the last price
+        Cancelled,
+        Rejected,        // Order refused by the venue
+        CancelRejected,  // Cancel or amend refused; the order stays live as last acknowledged
+        Amended,         // Modify accepted; the order now has the requested price and quantity
+    };
+
+    Kind kind = Kind::New;
+    uint64_t order_id = 0;
+    size_t last_quantity = 0;
+    Price last_ticks = 0;     // Valid when has_ticks
+    double last_price = 0.0;  // Decimal price from text protocols otherwise
+    bool has_ticks = false;
+};
+
+// Order manager
+// Requests fan in from every strategy thread and market maker, so the request queue is
+// multi-producer. The live-order table is owned by the processing thread; submitters never touch
+// it, so cancel and modify are fire-and-forget and their outcome is reported through the log.
+// With a gateway attached, the order thread also drives the venue session: it flushes outbound
+// messages and applies execution reports between requests, so order state stays single-threaded.
+// The risk policy is a template parameter, so pre-trade checks inline into the order path. It
+// needs check_order(const Order&), check_orders(std::span<const Order>) returning an accepted
+// mask, release(const Order&, size_t), on_fill(const Order&, const Trade&) and
+// reserve_overfill(const Order&, size_t), an unchecked reservation (also taken for restored orders).
+// The live table keeps each order as the venue last acknowledged it. An amend waits beside it
+// until the venue answers: an increase is reserved when sent, a decrease is released on the ack,
+// and a refusal drops the amend and hands back whatever it reserved.
+// Every change to the live table and every fill is also sent to the order journal when one is
+// attached (see journal); the order thread only pushes a record onto its logger ring.
+template<typename RiskPolicy = RiskManager>
+class BasicOrderManager {
+private:
+    static constexpr size_t GATEWAY_POLL_INTERVAL = 32;  // Requests between gateway polls under load
+    static constexpr size_t GAUGE_INTERVAL = 16;         // Requests between queue depth samples
+
+    struct OrderState {
+        Order order;  // Price and quantity as last acknowledged
+        size_t filled = 0;
+        bool cancel_pending = false;  // Cancel sent to the venue, awaiting its report
+        bool amend_pending = false;   // Modify sent, awaiting Amended or CancelRejected
+        Price amend_price = 0;
+        size_t amend_quantity = 0;
+    };
+
+    // Type-erased only at attach time, like MarketDataHandler listeners
+    struct GatewayHooks {
+        void* gateway = nullptr;
+        bool (*send)(void* gateway, OrderRequestType type, const Order& order) = nullptr;
+        void (*poll)(void* gateway, BasicOrderManager& manager) = nullptr;
+    };
+
+    struct FillListener {
+        void* listener;
+        void (*on_fill)(void* listener, const Trade& fill);
+    };
+
+    struct CloseListener {
+        void* listener;
+        void (*on_order_closed)(void* listener, const Order& order);
+    };
+
+    struct AmendListener {
+        void* listener;
+        void (*on_order_amended)(void* listener, const Order& order);
+    };
+
+    MpmcQueue<OrderRequest, 4096> request_queue_;
+    QueueGauge request_gauge_{decltype(request_queue_)::capacity()};
+    WaitStrategy waiter_;
+    RiskPolicy& risk_manager_;
+    FlatIdMap<OrderState> orders_;  // order_id -> live state
+    std::atomic<size_t> live_orders_{0};
+    std::atomic<uint64_t> suppressed_amends_{0};
+    GatewayHooks gateway_;
+    std::vector<FillListener> fill_listeners_;
+    std::vector<CloseListener> close_listeners_;
+    std::vector<AmendListener> amend_listeners_;
+    std::thread processing_thread_;
+    std::atomic<bool> running_{true};
+
+public:
+    using risk_policy = RiskPolicy;
+
+    explicit BasicOrderManager(RiskPolicy& risk_manager, WaitMode wait_mode = WaitMode::BusySpin,
+                               size_t max_live_orders = 65536)
+        : waiter_(wait_mode), risk_manager_(risk_manager), orders_(max_live_orders) {
+        MetricsRegistry& metrics = MetricsRegistry::instance();
+        std::string index = std::to_string(metrics.next_instance("order_manager"));
+        metrics.add_queue(this, "queue=\"order_requests\",order_manager=\"" + index + "\"", request_gauge_);
+        metrics.add_value(this, "live_orders", "order_manager=\"" + index + "\"", live_orders_);
+    }
+
+    ~BasicOrderManager() {
+        MetricsRegistry::instance().remove_gauges(this);
+    }
+
+    // Routes orders to a venue instead of only logging them; before start(). The gateway needs
+    // bool send(OrderRequestType, const Order&) and poll(handler), where poll flushes pending
+    // output and calls handler(const ExecutionReport&) for each decoded report.
+    template<typename Gateway>
+    void attach_gateway(Gateway& gateway) {
+        gateway_.gateway = &gateway;
+        gateway_.send = [](void* self, OrderRequestType type, const Order& order) {
+            return static_cast<Gateway*>(self)->send(type, order);
+        };
+        gateway_.poll = [](void* self, BasicOrderManager& manager) {
+            static_cast<Gateway*>(self)->poll([&manager](const ExecutionReport& report) {
+                manager.apply_execution(report);
+            });
+        };
+    }
+
+    // Registers for on_fill(const Trade&) on the order thread for every venue fill; before start()
+    template<typename Listener>
+    void subscribe_fills(Listener& listener) {
+        fill_listeners_.push_back(FillListener{&listener, [](void* self, const Trade& fill) {
+            static_cast<Listener*>(self)->on_fill(fill);
+        }});
+    }
+
+    // Registers for on_order_closed(const Order&) on the order thread whenever an order leaves
+    // the live table: filled, cancelled or rejected; before start()
+    template<typename Listener>
+    void subscribe_closes(Listener& listener) {
+        close_listeners_.push_back(CloseListener{&listener, [](void* self, const Order& order) {
+            static_cast<Listener*>(self)->on_order_closed(order);
+        }});
+    }
+
+    // Registers for on_order_amended(const Order&) on the order thread once each amend of a live
+    // order is settled by the venue or dropped here, with the order as it then stands; before start()
+    template<typename Listener>
+    void subscribe_amends(Listener& listener) {
+        amend_listeners_.push_back(AmendListener{&listener, [](void* self, const Order& order) {
+            static_cast<Listener*>(self)->on_order_amended(order);
+        }});
+    }
+
+    // Warm restart, before start(): takes back an order that was live at the last shutdown (see
+    // OrderLedger::restore_orders) as last acknowledged, so its fills and close are applied. Its
+    // unfilled quantity is reserved unchecked, since the order is already working. Nothing is
+    // journaled: the ledger already has it open. False if the id is taken or the table is full.
+    bool restore_order(const Order& order, size_t filled) {
+        if (!orders_.insert(order.order_id, OrderState{order, filled})) {
+            log_event(LogFormat::OrderRequestRejected, order.order_id, "duplicate_or_table_full");
+            return false;
+        }
+        live_orders_.fetch_add(1, std::memory_order_relaxed);
+        if (order.quantity > filled) {
+            risk_manager_.reserve_overfill(order, order.quantity - filled);
+        }
+        return true;
+    }
+
+    void start() {
+        processing_thread_ = std::thread([this]() {
+            size_t since_poll = 0;
+            size_t since_observe = 0;
+            while (running_) {
+                RcuDomain::quiescent();  // Risk policies read config snapshots
+                if (request_queue_.try_consume([this](OrderRequest& request) {
+                    int64_t start = LatencyClock::now_ns();
+                    if (request.order.timestamp.count() != 0) {
+                        record_latency(LatencyStage::OrderQueue, start - request.order.timestamp.count());
+                    }
+                    apply(request);
+                    record_latency(LatencyStage::OrderProcess, LatencyClock::now_ns() - start);
+                })) {
+                    waiter_.reset();
+                    if (++since_observe == GAUGE_INTERVAL) {
+                        request_gauge_.observe(request_queue_.size() + 1);  // Depth at the dequeue
+                        since_observe = 0;
+                    }
+                    if (gateway_.gateway && ++since_poll == GATEWAY_POLL_INTERVAL) {
+                        gateway_.poll(gateway_.gateway, *this);
+                        since_poll = 0;
+                    }
+                } else if (gateway_.gateway) {
+                    request_gauge_.observe(0);
+                    // A socket cannot wake the waiter, so a gateway session busy-polls
+                    gateway_.poll(gateway_.gateway, *this);
+                    since_poll = 0;
+                    cpu_relax();
+                } else {
+                    request_gauge_.observe(0);
+                    waiter_.idle([this] { return !request_queue_.empty() || !running_; });
+                }
+            }
+        });
+    }
+
+    void stop() {
+        running_ = false;
+        waiter_.notify();
+        if (processing_thread_.joinable()) {
+            processing_thread_.join();
+        }
+    }
+
+    // Safe to call from any thread
+    [[nodiscard]] SubmitStatus submit_order(const Order& order) {
+        bool accepted;
+        {
+            ScopedLatency timer(LatencyStage::RiskCheck);
+            accepted = risk_manager_.check_order(order);
+        }
+        if (!accepted) {
+            return SubmitStatus::RiskRejected;
+        }
+        if (!enqueue(OrderRequest{OrderRequestType::New, 0, order})) {
+            risk_manager_.release(order, order.quantity);
+            return SubmitStatus::QueueFull;
+        }
+        return SubmitStatus::Accepted;
+    }
+
+    // One risk pass and one queue claim for up to MAX_ORDER_BATCH orders; later orders are ignored
+    [[nodiscard]] BatchSubmitStatus submit_orders(std::span<const Order> orders) {
+        size_t n = std::min(orders.size(), MAX_ORDER_BATCH);
+        uint64_t considered = n == 64 ? ~uint64_t{0} : (uint64_t{1} << n) - 1;
+        uint64_t accepted;
+        {
+            ScopedLatency timer(LatencyStage::RiskCheck);
+            accepted = risk_manager_.check_orders(orders.first(n));
+        }
+        BatchSubmitStatus status{0, considered & ~accepted};
+
+        OrderRequest requests[MAX_ORDER_BATCH];
+        size_t count = 0;
+        for (uint64_t bits = accepted; bits; bits &= bits - 1) {
+            requests[count++] = OrderRequest{OrderRequestType::New, 0, orders[std::countr_zero(bits)]};
+        }
+        if (count == 0) {
+            return status;
+        }
+        if (!request_queue_.push_n(requests, count)) {
+            count_metric(Metric::OrderQueueFull, count);
+            for (size_t i = 0; i < count; ++i) {
+                risk_manager_.release(requests[i].order, requests[i].order.quantity);
+            }
+            return status;
+        }
+        waiter_.notify();
+        status.accepted = accepted;
+        return status;
+    }
+
+    // Releases the unfilled quantity's risk reservation once applied
+    [[nodiscard]] SubmitStatus cancel_order(uint64_t order_id) {
+        OrderRequest request;
+        request.type = OrderRequestType::Cancel;
+        request.order.order_id = order_id;
+        request.order.timestamp = get_current_timestamp();
+        return enqueue(request) ? SubmitStatus::Accepted : SubmitStatus::QueueFull;
+    }
+
+    // In-flight amend. A quantity increase is risk-checked for the difference on the order
+    // thread; amends that change nothing are dropped there without reaching the venue.
+    [[nodiscard]] SubmitStatus modify_order(uint64_t order_id, Price price, size_t quantity) {
+        OrderRequest request;
+        request.type = OrderRequestType::Modify;
+        request.order.order_id = order_id;
+        request.order.price = price;
+        request.order.quantity = quantity;
+        request.order.timestamp = get_current_timestamp();
+        return enqueue(request) ? SubmitStatus::Accepted : SubmitStatus::QueueFull;
+    }
+
+    // Cancel order_id and send replacement (with its own id) in one request
+    [[nodiscard]] SubmitStatus replace_order(uint64_t order_id, const Order& replacement) {
+        bool accepted;
+        {
+            ScopedLatency timer(LatencyStage::RiskCheck);
+            accepted = risk_manager_.check_order(replacement);
+        }
+        if (!accepted) {
+            return SubmitStatus::RiskRejected;
+        }
+        if (!enqueue(OrderRequest{OrderRequestType::Replace, order_id, replacement})) {
+            risk_manager_.release(replacement, replacement.quantity);
+            return SubmitStatus::QueueFull;
+        }
+        return SubmitStatus::Accepted;
+    }
+
+    // Requests accepted but not yet processed
+    size_t backlog() const {
+        return request_queue_.size();
+    }
+
+    size_t live_orders() const {
+        return live_orders_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t suppressed_amends() const {
+        return suppressed_amends_.load(std::memory_order_relaxed);
+    }
+
+private:
+    bool enqueue(const OrderRequest& request) {
+        if (!request_queue_.push(request)) {
+            count_metric(Metric::OrderQueueFull);
+            return false;
+        }
+        waiter_.notify();
+        return true;
+    }
+
+    void apply(const OrderRequest& request) {
+        switch (request.type) {
+        case OrderRequestType::New:
+            open_order(request.order);
+            break;
+        case OrderRequestType::Cancel:
+            cancel_live(request.order.order_id);
+            break;
+        case OrderRequestType::Modify:
+            amend_live(request.order);
+            break;
+        case OrderRequestType::Replace:
+            cancel_live(request.replaces);
+            open_order(request.order);
+            break;
+        }
+    }
+
+    void open_order(const Order& order) {
+        if (!orders_.insert(order.order_id, OrderState{order, 0})) {
+            risk_manager_.release(order, order.quantity);
+            log_event(LogFormat::OrderRequestRejected, order.order_id, "duplicate_or_table_full");
+            return;
+        }
+        live_orders_.fetch_add(1, std::memory_order_relaxed);
+        journal_event(LogFormat::JournalOrderOpened, order.order_id, LogSymbol{order.symbol}, order.is_buy,
+                      order.price, order.quantity);
+        process_order(order);
+    }
+
+    void cancel_live(uint64_t order_id) {
+        OrderState* state = orders_.find(order_id);
+        if (!state) {
+            log_event(LogFormat::OrderRequestRejected, order_id, "unknown_order");
+            return;
+        }
+        if (gateway_.gateway) {
+            // Fills can still race the cancel, so the order stays live until the venue reports
+            if (!state->cancel_pending) {
+                if (gateway_.send(gateway_.gateway, OrderRequestType::Cancel, state->order)) {
+                    state->cancel_pending = true;
+                } else {
+                    count_metric(Metric::GatewayFull);
+                    log_event(LogFormat::OrderRequestRejected, order_id, "gateway_full");
+                }
+            }
+            return;
+        }
+        close_order(order_id, *state);
+    }
+
+    // Quantity still held with the risk policy: the larger of the acknowledged and pending sizes
+    static size_t reserved_quantity(const OrderState& state) {
+        size_t held = state.amend_pending ? std::max(state.order.quantity, state.amend_quantity)
+                                          : state.order.quantity;
+        return held > state.filled ? held - state.filled : 0;
+    }
+
+    // Drops a live order and releases its unfilled reservation
+    void close_order(uint64_t order_id, OrderState& state) {
+        size_t remaining = reserved_quantity(state);
+        risk_manager_.release(state.order, remaining);
+        log_event(LogFormat::OrderCancelled, order_id, LogSymbol{state.order.symbol}, remaining);
+        retire(order_id, state);
+    }
+
+    void retire(uint64_t order_id, OrderState& state) {
+        Order order = state.order;
+        journal_event(LogFormat::JournalOrderClosed, order_id, LogSymbol{order.symbol});
+        orders_.erase(order_id);
+        live_orders_.fetch_sub(1, std::memory_order_relaxed);
+        for (const auto& listener : close_listeners_) {
+            listener.on_order_closed(listener.listener, order);
+        }
+    }
+
+    void amend_live(const Order& amend) {
+        OrderState* state = orders_.find(amend.order_id);
+        if (!state) {
+            log_event(LogFormat::OrderRequestRejected, amend.order_id, "unknown_order");  // Its close was reported
+            return;
+        }
+        if (amend.quantity <= state->filled && !gateway_.gateway) {
+            close_order(amend.order_id, *state);
+            return;
+        }
+        if (!begin_amend(*state, amend)) {
+            notify_amend(state->order);
+        }
+    }
+
+    // True once the amend is pending at the venue (or applied, without one); false if dropped
+    bool begin_amend(OrderState& state, const Order& amend) {
+        const Order& live = state.order;
+        if (amend.price == live.price && amend.quantity == live.quantity) {
+            suppressed_amends_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        if (amend.quantity <= state.filled) {
+            cancel_live(amend.order_id);
+            return false;
+        }
+        if (state.cancel_pending) {
+            log_event(LogFormat::OrderRequestRejected, amend.order_id, "cancel_pending");
+            return false;
+        }
+        if (state.amend_pending) {
+            // One amend in flight, so each venue answer matches the amend it refers to
+            log_event(LogFormat::OrderRequestRejected, amend.order_id, "amend_pending");
+            return false;
+        }
+        Order delta = live;
+        if (amend.quantity > live.quantity) {
+            delta.quantity = amend.quantity - live.quantity;
+            if (!risk_manager_.check_order(delta)) {
+                log_event(LogFormat::OrderRequestRejected, amend.order_id, "risk_rejected");
+                return false;
+            }
+        }
+        Order amended = live;
+        amended.price = amend.price;
+        amended.quantity = amend.quantity;
+        if (gateway_.gateway && !gateway_.send(gateway_.gateway, OrderRequestType::Modify, amended)) {
+            if (amend.quantity > live.quantity) {
+                risk_manager_.release(delta, delta.quantity);
+            }
+            count_metric(Metric::GatewayFull);
+            log_event(LogFormat::OrderRequestRejected, amend.order_id, "gateway_full");
+            return false;
+        }
+        state.amend_pending = true;
+        state.amend_price = amend.price;
+        state.amend_quantity = amend.quantity;
+        if (!gateway_.gateway) {
+            settle_amend(state, true);  // No venue to wait for
+        }
+        return true;
+    }
+
+    void notify_amend(const Order& order) {
+        for (const auto& listener : amend_listeners_) {
+            listener.on_order_amended(listener.listener, order);
+        }
+    }
+
+    // Venue answer to the pending amend: accepted commits it, refused leaves the order as it was.
+    // Either way the reservation shrinks to the size the order now has.
+    void settle_amend(OrderState& state, bool accepted) {
+        size_t held = reserved_quantity(state);
+        state.amend_pending = false;
+        if (accepted) {
+            state.order.price = state.amend_price;
+            state.order.quantity = state.amend_quantity;
+        }
+        if (size_t excess = held - reserved_quantity(state)) {
+            risk_manager_.release(state.order, excess);
+        }
+        const Order& live = state.order;
+        if (accepted) {
+            journal_event(LogFormat::JournalOrderAmended, live.order_id, LogSymbol{live.symbol}, live.price,
+                          live.quantity);
+            log_event(LogFormat::OrderModified, live.order_id, LogSymbol{live.symbol}, live.price, live.quantity);
+        } else {
+            log_event(LogFormat::OrderRequestRejected, live.order_id, "amend_rejected");
+        }
+        notify_amend(live);
+    }
+
+    void process_order(const Order& order) {
+        if (gateway_.gateway && !gateway_.send(gateway_.gateway, OrderRequestType::New, order)) {
+            count_metric(Metric::GatewayFull);
+            log_event(LogFormat::OrderRequestRejected, order.order_id, "gateway_full");
+            close_order(order.order_id, *orders_.find(order.order_id));
+            return;
+        }
+        log_event(LogFormat::OrderProcessed, order.order_id, LogSymbol{order.symbol},
+                  order.is_buy ? "buy" : "sell", order.price, order.quantity);
+    }
+
+    void apply_execution(const ExecutionReport& report) {
+        OrderState* state = orders_.find(report.order_id);
+        if (!state) {
+            log_event(LogFormat::OrderRequestRejected, report.order_id, "unknown_order");
+            return;
+        }
+        switch (report.kind) {
+        case ExecutionReport::Kind::New:
+            break;
+        case ExecutionReport::Kind::Fill: {
+            const Order& order = state->order;
+            size_t quantity = report.last_quantity;
+            // Applied in full: the venue's position is what it is, whatever size we think the order has
+            if (state->filled + quantity > order.quantity) {
+                count_metric(Metric::OrderOverfill);
+                log_event(LogFormat::OrderOverfilled, report.order_id, LogSymbol{order.symbol},
+                          state->filled + quantity, order.quantity);
+            }
+            if (size_t reserved = reserved_quantity(*state); quantity > reserved) {
+                risk_manager_.reserve_overfill(order, quantity - reserved);
+            }
+            state->filled += quantity;
+
+            Trade fill;
+            fill.symbol = order.symbol;
+            fill.price = report.has_ticks ? report.last_ticks : symbols().to_ticks(order.symbol, report.last_price);
+            fill.quantity = quantity;
+            fill.is_buy = order.is_buy;
+            fill.timestamp = get_current_timestamp();
+            journal_event(LogFormat::JournalFill, report.order_id, LogSymbol{fill.symbol}, fill.is_buy, fill.price,
+                          fill.quantity);
+            risk_manager_.on_fill(order, fill);
+            for (const auto& listener : fill_listeners_) {
+                listener.on_fill(listener.listener, fill);
+            }
+            if (state->filled >= order.quantity) {
+                // Done at the venue, so a pending increase will be refused there
+                if (size_t remaining = reserved_quantity(*state)) {
+                    risk_manager_.release(order, remaining);
+                }
+                retire(report.order_id, *state);
+            }
+            break;
+        }
+        case ExecutionReport::Kind::Cancelled:
+            close_order(report.order_id, *state);
+            break;
+        case ExecutionReport::Kind::Rejected:
+            count_metric(Metric::VenueRejected);
+            log_event(LogFormat::OrderRequestRejected, report.order_id, "venue_rejected");
+            close_order(report.order_id, *state);
+            break;
+        case ExecutionReport::Kind::CancelRejected:
+            // An amend is always sent before any cancel, so its answer comes first
+            if (state->amend_pending) {
+                settle_amend(*state, false);
+            } else {
+                state->cancel_pending = false;
+                log_event(LogFormat::OrderRequestRejected, report.order_id, "cancel_rejected");
+            }
+            break;
+        case ExecutionReport::Kind::Amended:
+            if (state->amend_pending) {
+                settle_amend(*state, true);
+            }
+            break;
+        }
+    }
+};
+
+using OrderManager = BasicOrderManager<>;
+
+enum class DispatchMode : uint8_t {
+    Inline,  // Callbacks run directly on the market data shard thread
+    Queued,  // Events go through a per-strategy inbox drained by the strategy's own thread
+};
+
+// Trading strategy
+// CRTP base for event-driven strategies. Derived provides on_quote, on_trade and on_book_update;
+// calls into it are resolved at compile time in both dispatch modes. OrderManagerType carries the
+// deployment's risk policy.
+template<typename Derived, typename OrderManagerType = OrderManager>
+class StrategyBase {
+private:
+    static constexpr size_t EVENT_BATCH = 64;
+
+    // Subscribed in Queued mode: forwards events from (possibly several) shard threads
+    struct Inbox {
+        StrategyBase& owner;
+
+        void on_quote(const Quote& quote) { owner.enqueue(MarketEvent(quote)); }
+        void on_trade(const Trade& trade) { owner.enqueue(MarketEvent(trade)); }
+        void on_book_update(SymbolId symbol, const TopOfBook& top) {
+            owner.enqueue(MarketEvent(symbol, top));
+        }
+    };
+
+    // Subscribed in Inline mode: times each callback on the shard thread
+    struct InlineDispatch {
+        StrategyBase& owner;
+
+        void on_quote(const Quote& quote) {
+            ScopedLatency timer(LatencyStage::StrategyDecision);
+            owner.derived().on_quote(quote);
+        }
+        void on_trade(const Trade& trade) {
+            ScopedLatency timer(LatencyStage::StrategyDecision);
+            owner.derived().on_trade(trade);
+        }
+        void on_book_update(SymbolId symbol, const TopOfBook& top) {
+            ScopedLatency timer(LatencyStage::StrategyDecision);
+            owner.derived().on_book_update(symbol, top);
+        }
+    };
+
+    DispatchMode dispatch_mode_;
+    MpmcQueue<MarketEvent, 4096> inbox_queue_;
+    QueueGauge inbox_gauge_{decltype(inbox_queue_)::capacity()};
+    Inbox inbox_{*this};
+    InlineDispatch inline_dispatch_{*this};
+    WaitStrategy waiter_;
+    std::atomic<bool> running_{true};
+    std::atomic<uint64_t> dropped_events_{0};
+    std::thread strategy_thread_;
+
+protected:
+    MarketDataHandler& market_data_;
+    OrderManagerType& order_manager_;
+
+    StrategyBase(MarketDataHandler& md, OrderManagerType& om, DispatchMode dispatch_mode,
+                 WaitMode wait_mode)
+        : dispatch_mode_(dispatch_mode), waiter_(wait_mode), market_data_(md), order_manager_(om) {
+        if (dispatch_mode_ == DispatchMode::Queued) {
+            MetricsRegistry& metrics = MetricsRegistry::instance();
+            metrics.add_queue(this, "queue=\"strategy_inbox\",strategy=\"" +
+                              std::to_string(metrics.next_instance("strategy")) + "\"", inbox_gauge_);
+        }
+    }
+
+    // Derived is already destroyed by now, so stopping here would leave the strategy thread (or,
+    // for Inline strategies, the shard threads) calling into a dead object. Owners stop() first;
+    // an Inline strategy's market data must be stopped before it is destroyed.
+    ~StrategyBase() {
+        assert(!strategy_thread_.joinable() && "StrategyBase destroyed without stop()");
+        MetricsRegistry::instance().remove_gauges(this);
+    }
+
+public:
+    using order_manager_type = OrderManagerType;
+
+    StrategyBase(const StrategyBase&) = delete;
+    StrategyBase& operator=(const StrategyBase&) = delete;
+
+    // Must be called before market data starts
+    void subscribe(SymbolId symbol) {
+        if (dispatch_mode_ == DispatchMode::Inline) {
+            market_data_.subscribe(symbol, inline_dispatch_);
+        } else {
+            market_data_.subscribe(symbol, inbox_);
+        }
+    }
+
+    void start() {
+        if (dispatch_mode_ != DispatchMode::Queued) {
+            return;  // Inline strategies run on the shard threads
+        }
+        strategy_thread_ = std::thread([this]() {
+            while (running_) {
+                size_t n = 0;
+                while (n < EVENT_BATCH && inbox_queue_.try_consume([this](MarketEvent& event) {
+                    ScopedLatency timer(LatencyStage::StrategyDecision);
+                    record_latency(LatencyStage::StrategyInbox,
+                                   LatencyClock::now_ns() - event.enqueue_ns);
+                    dispatch_market_event(derived(), event);
+                })) {
+                    ++n;
+                }
+                if (n) {
+                    inbox_gauge_.observe(n + inbox_queue_.size());  // Depth when the batch started
+                    waiter_.reset();
+                } else {
+                    inbox_gauge_.observe(0);
+                    waiter_.idle([this] { return !inbox_queue_.empty() || !running_; });
+                }
+            }
+        });
+    }
+
+    void stop() {
+        running_ = false;
+        waiter_.notify();
+        if (strategy_thread_.joinable()) {
+            strategy_thread_.join();
+        }
+    }
+
+    // Events discarded because the inbox was full; the shard thread never waits on a strategy
+    uint64_t dropped_events() const {
+        return dropped_events_.load(std::memory_order_relaxed);
+    }
+
+private:
+    Derived& derived() { return static_cast<Derived&>(*this); }
+
+    void enqueue(MarketEvent event) {
+        event.enqueue_ns = LatencyClock::now_ns();
+        if (inbox_queue_.push(event)) {
+            waiter_.notify();
+        } else {
+            dropped_events_.fetch_add(1, std::memory_order_relaxed);
+            count_metric(Metric::StrategyInboxFull);
+        }
+    }
+};
@@ -1,25 +1,27 @@
+#include <algorithm>
+#include <deque>
+#include <limits>
+#include <variant>
 #include "common.hpp"
 
-// Base class for all order types
+// Fields shared by all order types. There is no vtable: each type provides its own
+// should_trigger(const Quote&) and generate_order(), resolved statically or through
+// ConditionalOrder.
 class BaseOrder {
 public:
-    virtual ~BaseOrder() = default;
-    virtual bool should_trigger(const Quote& quote) = 0;
-    virtual Order generate_order() = 0;
-    
-    std::string order_id;
-    std::string symbol;
+    uint64_t order_id;
+    SymbolId symbol;
     bool is_buy;
-    double quantity;
+    size_t quantity;
     std::chrono::nanoseconds timestamp;
 };
 
 // Limit order
 class LimitOrder : public BaseOrder {
 public:
-    double limit_price;
+    Price limit_price;
 
-    bool should_trigger(const Quote& quote) override {
+    bool should_trigger(const Quote& quote) {
         if (is_buy) {
             return quote.ask <= limit_price;
         } else {
@@ -27,7 +29,7 @@ public:
         }
     }
 
-    Order generate_order() override {
+    Order generate_order() const {
         Order order;
         order.order_id = order_id;
         order.symbol = symbol;
@@ -42,9 +44,9 @@ public:
 // Stop order
 class StopOrder : public BaseOrder {
 public:
-    double stop_price;
+    Price stop_price;
 
-    bool should_trigger(const Quote& quote) override {
+    bool should_trigger(const Quote& quote) {
         if (is_buy) {
             return quote.ask >= stop_price;
         } else {
@@ -52,13 +54,13 @@ public:
         }
     }
 
-    Order generate_order() override {
+    Order generate_order() const {
         Order order;
         order.order_id = order_id;
         order.symbol = symbol;
         order.is_buy = is_buy;
         order.quantity = quantity;
-        order.price = 0.0;  // Market order when triggered
+        order.price = 0;  // Market order when triggered
         order.timestamp = timestamp;
         return order;
     }
@@ -67,11 +69,11 @@ public:
 // Stop-limit order
 class StopLimitOrder : public BaseOrder {
 public:
-    double stop_price;
-    double limit_price;
+    Price stop_price;
+    Price limit_price;
     bool stop_triggered = false;
 
-    bool should_trigger(const Quote& quote) override {
+    bool should_trigger(const Quote& quote) {
         if (!stop_triggered) {
             if (is_buy) {
                 stop_triggered = quote.ask >= stop_price;
@@ -88,7 +90,707 @@ public:
         }
     }
 
-    Order generate_order() override {
+    Order generate_order() const {
         Order order;
         order.order_id = order_id;
         order.symbol = symbol;
+        order.is_buy = is_buy;
+        order.quantity = quantity;
+        order.price = limit_price;
+        order.timestamp = timestamp;
+        return order;
+    }
+};
+
+// Trailing stop: the stop follows the best bid (sell) or ask (buy) at trail_distance ticks and only
+// ever tightens; becomes a market order once price retraces that far from its extreme
+class TrailingStopOrder : public BaseOrder {
+public:
+    Price trail_distance;
+    Price extreme = 0;
+    bool has_extreme = false;
+
+    bool should_trigger(const Quote& quote) {
+        if (is_buy) {
+            if (!has_extreme || quote.ask < extreme) {
+                extreme = quote.ask;
+            }
+            has_extreme = true;
+            return quote.ask >= extreme + trail_distance;
+        }
+        if (!has_extreme || quote.bid > extreme) {
+            extreme = quote.bid;
+        }
+        has_extreme = true;
+        return quote.bid <= extreme - trail_distance;
+    }
+
+    Order generate_order() const {
+        Order order;
+        order.order_id = order_id;
+        order.symbol = symbol;
+        order.is_buy = is_buy;
+        order.quantity = quantity;
+        order.price = 0;  // Market order when triggered
+        order.timestamp = timestamp;
+        return order;
+    }
+};
+
+// Iceberg: works immediately as a limit order showing at most display_quantity at a time;
+// each fully filled child is replaced by the next slice of the hidden remainder
+class IcebergOrder : public BaseOrder {
+public:
+    Price limit_price;
+    size_t display_quantity;
+
+    bool should_trigger(const Quote&) {
+        return true;
+    }
+
+    // First visible slice
+    Order generate_order() const {
+        Order order;
+        order.order_id = order_id;
+        order.symbol = symbol;
+        order.is_buy = is_buy;
+        order.quantity = std::min(quantity, display_quantity);
+        order.price = limit_price;
+        order.timestamp = timestamp;
+        return order;
+    }
+};
+
+// Any resting conditional order, held by value. Heterogeneous orders share one array or one
+// LockFreeAllocator<ConditionalOrder> pool, and dispatch is a switch on the index.
+using ConditionalOrder = std::variant<LimitOrder, StopOrder, StopLimitOrder, TrailingStopOrder>;
+
+inline bool should_trigger(ConditionalOrder& order, const Quote& quote) {
+    return std::visit([&quote](auto& o) { return o.should_trigger(quote); }, order);
+}
+
+inline Order generate_order(const ConditionalOrder& order) {
+    return std::visit([](const auto& o) { return o.generate_order(); }, order);
+}
+
+// One-cancels-other: whichever leg fires first cancels the other
+template<typename First, typename Second>
+struct OcoOrder {
+    First first;
+    Second second;
+};
+
+// Limit entry; every fill arms an OCO exit pair sized to the filled quantity on the opposite side:
+// a take-profit limit and a stop-loss stop
+struct BracketOrder {
+    LimitOrder entry;
+    Price take_profit;
+    Price stop_loss;
+};
+
+// Price-indexed trigger engine for conditional orders.
+// Pending orders sit in four heaps per symbol keyed by trigger price, one per crossing direction,
+// so a quote pops only the orders it actually crossed instead of polling every order. Entries
+// carry a sequence number for FIFO among equal prices and for lazy invalidation on cancel.
+// Trailing stops are grouped by side and trail distance (see TrailGroup), icebergs keep one
+// pooled child working at a time, and OCO / bracket legs are linked slots.
+// Single-threaded: drive it from the thread that sees the symbol's quotes and fills (e.g. an
+// Inline subscription on its market data shard).
+class TriggerEngine {
+private:
+    static constexpr uint32_t NONE = ~uint32_t{0};
+    static constexpr uint32_t CHILD_TAG = 1u << 31;  // index_ value refers to an iceberg child
+    static constexpr Price LOWEST = std::numeric_limits<Price>::min() / 2;
+
+    enum class Kind : uint8_t { Limit, Stop, StopLimit, TrailingStop, Iceberg, BracketEntry };
+
+    // Which market move fires an entry: buy limits and sell stops wait for prices to fall.
+    // WORKING: not waiting on price (iceberg parents, bracket entries sent and awaiting fills).
+    enum Direction : uint8_t { AskFalls, AskRises, BidRises, BidFalls, DIRECTIONS, WORKING = DIRECTIONS, TRAILING };
+
+    struct Pending {
+        Order order;             // Emitted as-is once the order fires
+        Price stop_price = 0;    // StopLimit stop, TrailingStop distance, bracket stop-loss
+        Price target_price = 0;  // Bracket take-profit
+        size_t hidden = 0;       // Iceberg quantity not yet shown
+        size_t display = 0;      // Iceberg slice size
+        size_t filled = 0;       // Bracket entry fills so far
+        uint64_t seq = 0;        // 0 when the slot is free
+        uint32_t exits[2] = {NONE, NONE};  // Bracket entry: armed take-profit / stop-loss legs
+        uint32_t partner = NONE;  // Other OCO leg
+        uint32_t parent = NONE;   // Bracket entry an exit leg protects
+        uint32_t aux = NONE;      // Trailing group index, or iceberg child handle
+        Kind kind = Kind::Limit;
+        Direction where = WORKING;
+    };
+
+    struct Entry {
+        Price price;
+        uint64_t seq;
+        uint32_t slot;
+    };
+
+    struct Heap {
+        std::vector<Entry> entries;
+        size_t stale = 0;  // Cancelled entries not yet popped
+    };
+
+    // Trailing stops of one side and trail distance, in a monotone cohort deque.
+    // Prices are mapped so a higher value is always better for the order (bid for sells, -ask for
+    // buys); an order's peak is the best value seen since it was added. Every order has seen the
+    // latest quote, so the newest order has the lowest peak, and a new extreme lifts a run of the
+    // newest cohorts to the same peak: they merge. Members are stored newest-first and cohorts
+    // partition them in order. The oldest cohort has the highest peak and fires first, all its
+    // members at once, when value <= peak - distance. Peaks re-key only when the extreme moves.
+    struct TrailCohort {
+        Price peak;
+        size_t count;  // Members, including cancelled ones not yet dropped
+    };
+
+    struct TrailMember {
+        uint32_t slot;
+        uint64_t seq;
+    };
+
+    struct TrailGroup {
+        Price distance = 0;
+        bool is_buy = false;
+        std::deque<TrailCohort> cohorts;  // Front: newest, lowest peak
+        std::deque<TrailMember> members;  // Front: newest
+        size_t stale = 0;
+    };
+
+    struct SymbolTriggers {
+        Heap heaps[DIRECTIONS];
+        std::vector<TrailGroup> trails;
+        Price last_bid = 0;
+        Price last_ask = 0;
+        bool has_quote = false;
+    };
+
+    struct IcebergChild {
+        uint64_t order_id = 0;
+        size_t open = 0;
+        uint32_t parent = NONE;
+    };
+
+    std::vector<SymbolTriggers> books_{MAX_SYMBOLS};
+    std::vector<Pending> pending_;
+    std::vector<uint32_t> free_slots_;
+    FlatIdMap<uint32_t> index_;  // order_id -> slot, or child handle | CHILD_TAG
+    LockFreeAllocator<IcebergChild> children_;
+    uint64_t next_seq_ = 1;
+    uint64_t next_child_id_;
+    uint64_t examined_ = 0;
+
+    // True when a should sit above b: max-heap on price for falling triggers, min-heap for rising,
+    // and earlier sequence first at equal prices
+    static bool below(Direction d, const Entry& a, const Entry& b) {
+        if (a.price != b.price) {
+            return (d == AskFalls || d == BidFalls) ? a.price < b.price : a.price > b.price;
+        }
+        return a.seq > b.seq;
+    }
+
+    static bool crossed(Direction d, Price trigger, const Quote& quote) {
+        switch (d) {
+        case AskFalls: return quote.ask <= trigger;
+        case AskRises: return quote.ask >= trigger;
+        case BidRises: return quote.bid >= trigger;
+        default:       return quote.bid <= trigger;
+        }
+    }
+
+    static Direction limit_direction(bool is_buy) { return is_buy ? AskFalls : BidRises; }
+    static Direction stop_direction(bool is_buy) { return is_buy ? AskRises : BidFalls; }
+
+    static Price trail_value(bool is_buy, Price bid, Price ask) { return is_buy ? -ask : bid; }
+
+    void push(SymbolId symbol, Direction d, Price price, uint32_t slot) {
+        Pending& p = pending_[slot];
+        p.where = d;
+        Heap& heap = books_[symbol].heaps[d];
+        heap.entries.push_back(Entry{price, p.seq, slot});
+        std::push_heap(heap.entries.begin(), heap.entries.end(),
+                       [d](const Entry& a, const Entry& b) { return below(d, a, b); });
+    }
+
+    void push_trailing(uint32_t slot) {
+        Pending& p = pending_[slot];
+        SymbolTriggers& book = books_[p.order.symbol];
+        uint32_t g = 0;
+        while (g < book.trails.size() &&
+               (book.trails[g].is_buy != p.order.is_buy || book.trails[g].distance != p.stop_price)) {
+            ++g;
+        }
+        if (g == book.trails.size()) {
+            book.trails.emplace_back();
+            book.trails[g].distance = p.stop_price;
+            book.trails[g].is_buy = p.order.is_buy;
+        }
+        TrailGroup& group = book.trails[g];
+        Price peak = book.has_quote ? trail_value(p.order.is_buy, book.last_bid, book.last_ask) : LOWEST;
+        if (group.cohorts.empty() || group.cohorts.front().peak != peak) {
+            group.cohorts.push_front(TrailCohort{peak, 0});
+        }
+        ++group.cohorts.front().count;
+        group.members.push_front(TrailMember{slot, p.seq});
+        p.where = TRAILING;
+        p.aux = g;
+    }
+
+    // Claims a slot for base and indexes it under its id; NONE if full, duplicate or out of range
+    uint32_t claim(const BaseOrder& base, Kind kind, Price order_price) {
+        if (base.symbol >= MAX_SYMBOLS || free_slots_.empty()) {
+            return NONE;
+        }
+        uint32_t slot = free_slots_.back();
+        if (!index_.insert(base.order_id, slot)) {
+            return NONE;
+        }
+        free_slots_.pop_back();
+
+        Pending& p = pending_[slot];
+        p = Pending{};
+        p.order.order_id = base.order_id;
+        p.order.symbol = base.symbol;
+        p.order.is_buy = base.is_buy;
+        p.order.quantity = base.quantity;
+        p.order.price = order_price;
+        p.order.timestamp = base.timestamp;
+        p.seq = next_seq_++;
+        p.kind = kind;
+        return slot;
+    }
+
+    uint32_t add_slot(const LimitOrder& order) {
+        uint32_t slot = claim(order, Kind::Limit, order.limit_price);
+        if (slot != NONE) {
+            push(order.symbol, limit_direction(order.is_buy), order.limit_price, slot);
+        }
+        return slot;
+    }
+
+    uint32_t add_slot(const StopOrder& order) {
+        uint32_t slot = claim(order, Kind::Stop, 0);  // Market order when triggered
+        if (slot != NONE) {
+            pending_[slot].stop_price = order.stop_price;
+            push(order.symbol, stop_direction(order.is_buy), order.stop_price, slot);
+        }
+        return slot;
+    }
+
+    uint32_t add_slot(const StopLimitOrder& order) {
+        uint32_t slot = claim(order, Kind::StopLimit, order.limit_price);
+        if (slot != NONE) {
+            pending_[slot].stop_price = order.stop_price;
+            push(order.symbol, stop_direction(order.is_buy), order.stop_price, slot);
+        }
+        return slot;
+    }
+
+    uint32_t add_slot(const TrailingStopOrder& order) {
+        if (order.trail_distance <= 0) {
+            return NONE;
+        }
+        uint32_t slot = claim(order, Kind::TrailingStop, 0);  // Market order when triggered
+        if (slot != NONE) {
+            pending_[slot].stop_price = order.trail_distance;
+            push_trailing(slot);
+        }
+        return slot;
+    }
+
+    void release(uint32_t slot) {
+        index_.erase(pending_[slot].order.order_id);
+        pending_[slot].seq = 0;
+        free_slots_.push_back(slot);
+    }
+
+    void release_child(uint32_t handle) {
+        index_.erase(children_[handle].order_id);
+        children_.destroy(&children_[handle]);
+    }
+
+    // Severs OCO and bracket links, discarding the OCO partner
+    void unlink(uint32_t slot) {
+        Pending& p = pending_[slot];
+        if (p.parent != NONE) {
+            Pending& entry = pending_[p.parent];
+            for (uint32_t& exit : entry.exits) {
+                if (exit == slot) {
+                    exit = NONE;
+                }
+            }
+            p.parent = NONE;
+        }
+        if (p.kind == Kind::BracketEntry) {
+            for (uint32_t exit : p.exits) {
+                if (exit != NONE) {
+                    pending_[exit].parent = NONE;
+                }
+            }
+        }
+        if (p.partner != NONE) {
+            uint32_t other = p.partner;
+            p.partner = NONE;
+            pending_[other].partner = NONE;
+            discard(other);
+        }
+    }
+
+    // Removes a live slot wherever it waits; its heap or trailing entry goes stale
+    void discard(uint32_t slot) {
+        Pending& p = pending_[slot];
+        if (p.where < DIRECTIONS) {
+            ++books_[p.order.symbol].heaps[p.where].stale;
+        } else if (p.where == TRAILING) {
+            ++books_[p.order.symbol].trails[p.aux].stale;
+        }
+        if (p.kind == Kind::Iceberg && p.aux != NONE) {
+            release_child(p.aux);  // The working child is the caller's to cancel at the venue
+        }
+        unlink(slot);
+        release(slot);
+    }
+
+    // Drops cancelled entries once they make up most of a heap
+    void compact(Direction d, Heap& heap) {
+        if (heap.stale * 2 <= heap.entries.size() || heap.entries.size() < 64) {
+            return;
+        }
+        auto live_end = std::remove_if(heap.entries.begin(), heap.entries.end(), [this](const Entry& e) {
+            return pending_[e.slot].seq != e.seq;
+        });
+        heap.entries.erase(live_end, heap.entries.end());
+        std::make_heap(heap.entries.begin(), heap.entries.end(),
+                       [d](const Entry& a, const Entry& b) { return below(d, a, b); });
+        heap.stale = 0;
+    }
+
+    void compact(TrailGroup& group) {
+        if (group.stale * 2 <= group.members.size() || group.members.size() < 64) {
+            return;
+        }
+        std::deque<TrailCohort> cohorts;
+        std::deque<TrailMember> members;
+        size_t next = 0;
+        for (const TrailCohort& cohort : group.cohorts) {
+            size_t live = 0;
+            for (size_t i = 0; i < cohort.count; ++i, ++next) {
+                const TrailMember& m = group.members[next];
+                if (pending_[m.slot].seq == m.seq) {
+                    members.push_back(m);
+                    ++live;
+                }
+            }
+            if (live) {
+                cohorts.push_back(TrailCohort{cohort.peak, live});
+            }
+        }
+        group.cohorts.swap(cohorts);
+        group.members.swap(members);
+        group.stale = 0;
+    }
+
+    template<typename Emit>
+    void fire_order(uint32_t slot, Emit& emit) {
+        Pending& p = pending_[slot];
+        Order order = p.order;
+        if (p.kind == Kind::BracketEntry) {
+            p.where = WORKING;  // Kept to arm exits as fills come back
+            emit(order);
+            return;
+        }
+        unlink(slot);
+        release(slot);
+        emit(order);
+    }
+
+    template<typename Emit>
+    void fire(SymbolTriggers& book, Direction d, const Quote& quote, Emit& emit) {
+        Heap& heap = book.heaps[d];
+        auto cmp = [d](const Entry& a, const Entry& b) { return below(d, a, b); };
+        while (!heap.entries.empty() && crossed(d, heap.entries.front().price, quote)) {
+            std::pop_heap(heap.entries.begin(), heap.entries.end(), cmp);
+            Entry entry = heap.entries.back();
+            heap.entries.pop_back();
+            ++examined_;
+
+            Pending& p = pending_[entry.slot];
+            if (p.seq != entry.seq) {
+                --heap.stale;
+                continue;
+            }
+            if (p.kind == Kind::StopLimit && (d == AskRises || d == BidFalls)) {
+                // Stop crossed: live from now on as a limit order at its limit price
+                push(quote.symbol, limit_direction(p.order.is_buy), p.order.price, entry.slot);
+                continue;
+            }
+            fire_order(entry.slot, emit);
+        }
+    }
+
+    template<typename Emit>
+    void fire_trailing(TrailGroup& group, const Quote& quote, Emit& emit) {
+        if (group.members.empty()) {
+            return;
+        }
+        Price value = trail_value(group.is_buy, quote.bid, quote.ask);
+        while (!group.cohorts.empty() && value <= group.cohorts.back().peak - group.distance) {
+            size_t count = group.cohorts.back().count;
+            group.cohorts.pop_back();
+            for (size_t i = 0; i < count; ++i) {
+                TrailMember m = group.members.back();
+                group.members.pop_back();
+                ++examined_;
+                if (pending_[m.slot].seq != m.seq) {
+                    --group.stale;
+                    continue;
+                }
+                fire_order(m.slot, emit);
+            }
+        }
+        // New extreme for the newest cohorts: they now share one peak
+        if (!group.cohorts.empty() && group.cohorts.front().peak <= value) {
+            size_t merged = 0;
+            while (!group.cohorts.empty() && group.cohorts.front().peak <= value) {
+                merged += group.cohorts.front().count;
+                group.cohorts.pop_front();
+            }
+            group.cohorts.push_front(TrailCohort{value, merged});
+        }
+    }
+
+    // Sends the next slice of an iceberg; false if nothing is left or no child could be allocated
+    template<typename Emit>
+    bool refresh_iceberg(uint32_t slot, Emit& emit) {
+        Pending& p = pending_[slot];
+        if (p.hidden == 0) {
+            return false;
+        }
+        IcebergChild* child = children_.create();
+        if (!child) {
+            return false;
+        }
+        uint32_t handle = children_.index_of(child);
+        child->order_id = next_child_id_++;
+        child->open = std::min(p.display, p.hidden);
+        child->parent = slot;
+        if (!index_.insert(child->order_id, handle | CHILD_TAG)) {
+            children_.destroy(child);
+            return false;
+        }
+        p.hidden -= child->open;
+        p.aux = handle;
+
+        Order order = p.order;
+        order.order_id = child->order_id;
+        order.quantity = child->open;
+        order.timestamp = get_current_timestamp();
+        emit(order);
+        return true;
+    }
+
+    // Adds quantity to the entry's exit pair, or arms a new pair; false if no slots are left
+    bool arm_exits(uint32_t entry_slot, size_t quantity) {
+        Pending& entry = pending_[entry_slot];
+        if (entry.exits[0] != NONE) {
+            pending_[entry.exits[0]].order.quantity += quantity;
+            pending_[entry.exits[1]].order.quantity += quantity;
+            return true;
+        }
+        if (free_slots_.size() < 2) {
+            return false;
+        }
+        LimitOrder take_profit;
+        take_profit.order_id = next_child_id_++;
+        take_profit.symbol = entry.order.symbol;
+        take_profit.is_buy = !entry.order.is_buy;
+        take_profit.quantity = quantity;
+        take_profit.timestamp = entry.order.timestamp;
+        take_profit.limit_price = entry.target_price;
+
+        StopOrder stop_loss;
+        stop_loss.order_id = next_child_id_++;
+        stop_loss.symbol = entry.order.symbol;
+        stop_loss.is_buy = !entry.order.is_buy;
+        stop_loss.quantity = quantity;
+        stop_loss.timestamp = entry.order.timestamp;
+        stop_loss.stop_price = entry.stop_price;
+
+        uint32_t tp = add_slot(take_profit);
+        if (tp == NONE) {
+            return false;
+        }
+        uint32_t sl = add_slot(stop_loss);
+        if (sl == NONE) {
+            discard(tp);
+            return false;
+        }
+        pending_[tp].partner = sl;
+        pending_[sl].partner = tp;
+        pending_[tp].parent = pending_[sl].parent = entry_slot;
+        entry.exits[0] = tp;
+        entry.exits[1] = sl;
+        return true;
+    }
+
+public:
+    // Ids for iceberg children and bracket exits are drawn from child_id_base upwards and must not
+    // collide with caller ids
+    explicit TriggerEngine(size_t max_orders = 65536, uint64_t child_id_base = uint64_t{1} << 62)
+        : pending_(max_orders), index_(max_orders), children_(max_orders), next_child_id_(child_id_base) {
+        free_slots_.reserve(max_orders);
+        for (size_t i = max_orders; i-- > 0;) {
+            free_slots_.push_back(static_cast<uint32_t>(i));
+        }
+    }
+
+    // False if the engine is full, the id is already pending, or the symbol is out of range
+    bool add(const LimitOrder& order) { return add_slot(order) != NONE; }
+    bool add(const StopOrder& order) { return add_slot(order) != NONE; }
+    bool add(const StopLimitOrder& order) { return add_slot(order) != NONE; }
+    bool add(const TrailingStopOrder& order) { return add_slot(order) != NONE; }
+    bool add(const ConditionalOrder& order) {
+        return std::visit([this](const auto& o) { return add_slot(o) != NONE; }, order);
+    }
+
+    template<typename First, typename Second>
+    bool add(const OcoOrder<First, Second>& oco) {
+        uint32_t first = add_slot(oco.first);
+        if (first == NONE) {
+            return false;
+        }
+        uint32_t second = add_slot(oco.second);
+        if (second == NONE) {
+            discard(first);
+            return false;
+        }
+        pending_[first].partner = second;
+        pending_[second].partner = first;
+        return true;
+    }
+
+    bool add(const BracketOrder& bracket) {
+        uint32_t slot = claim(bracket.entry, Kind::BracketEntry, bracket.entry.limit_price);
+        if (slot == NONE) {
+            return false;
+        }
+        Pending& p = pending_[slot];
+        p.target_price = bracket.take_profit;
+        p.stop_price = bracket.stop_loss;
+        push(bracket.entry.symbol, limit_direction(bracket.entry.is_buy), bracket.entry.limit_price, slot);
+        return true;
+    }
+
+    // Emits the first slice right away; later slices follow from on_fill
+    template<typename Emit>
+    bool add(const IcebergOrder& order, Emit&& emit) {
+        if (order.display_quantity == 0) {
+            return false;
+        }
+        uint32_t slot = claim(order, Kind::Iceberg, order.limit_price);
+        if (slot == NONE) {
+            return false;
+        }
+        pending_[slot].hidden = order.quantity;
+        pending_[slot].display = order.display_quantity;
+        if (!refresh_iceberg(slot, emit)) {
+            release(slot);
+            return false;
+        }
+        return true;
+    }
+
+    // Cancelling one OCO leg cancels both; cancelling a bracket entry leaves armed exits in place
+    bool cancel(uint64_t order_id) {
+        const uint32_t* found = index_.find(order_id);
+        if (!found || (*found & CHILD_TAG)) {
+            return false;
+        }
+        uint32_t slot = *found;
+        SymbolId symbol = pending_[slot].order.symbol;
+        discard(slot);
+        SymbolTriggers& book = books_[symbol];
+        for (int d = 0; d < DIRECTIONS; ++d) {
+            compact(static_cast<Direction>(d), book.heaps[d]);
+        }
+        for (TrailGroup& group : book.trails) {
+            compact(group);
+        }
+        return true;
+    }
+
+    // Fill report for an emitted iceberg child or bracket entry. May emit the next iceberg slice.
+    // False if the id is not tracked, or a bracket's exits could not be armed.
+    template<typename Emit>
+    bool on_fill(uint64_t order_id, size_t quantity, Emit&& emit) {
+        const uint32_t* found = index_.find(order_id);
+        if (!found) {
+            return false;
+        }
+        if (*found & CHILD_TAG) {
+            uint32_t handle = *found & ~CHILD_TAG;
+            IcebergChild& child = children_[handle];
+            child.open -= std::min(child.open, quantity);
+            if (child.open > 0) {
+                return true;
+            }
+            uint32_t parent = child.parent;
+            release_child(handle);
+            pending_[parent].aux = NONE;
+            if (!refresh_iceberg(parent, emit)) {
+                release(parent);
+            }
+            return true;
+        }
+        uint32_t slot = *found;
+        Pending& p = pending_[slot];
+        if (p.kind != Kind::BracketEntry || p.where != WORKING) {
+            return false;
+        }
+        p.filled += quantity;
+        bool armed = arm_exits(slot, quantity);
+        if (p.filled >= p.order.quantity) {
+            for (uint32_t exit : p.exits) {
+                if (exit != NONE) {
+                    pending_[exit].parent = NONE;
+                }
+            }
+            release(slot);
+        }
+        return armed;
+    }
+
+    // Calls emit(const Order&) for every order the quote fires. Stops run first so a stop-limit
+    // whose stop is crossed is checked against its limit on the same quote.
+    template<typename Emit>
+    void on_quote(const Quote& quote, Emit&& emit) {
+        if (quote.symbol >= MAX_SYMBOLS) {
+            return;
+        }
+        SymbolTriggers& book = books_[quote.symbol];
+        fire(book, AskRises, quote, emit);
+        fire(book, BidFalls, quote, emit);
+        for (TrailGroup& group : book.trails) {
+            fire_trailing(group, quote, emit);
+        }
+        fire(book, AskFalls, quote, emit);
+        fire(book, BidRises, quote, emit);
+        book.last_bid = quote.bid;
+        book.last_ask = quote.ask;
+        book.has_quote = true;
+    }
+
+    // Orders and iceberg children currently tracked
+    size_t pending() const {
+        return index_.size();
+    }
+
+    // Heap entries and trailing members taken off for a crossing so far, cancelled ones included.
+    // A quote only examines what it crossed, however many orders rest elsewhere.
+    uint64_t examined() const {
+        return examined_;
+    }
+};
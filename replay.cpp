@@ -0,0 +1,122 @@
+#include <random>
+#include "common.hpp"
+
+// Capture and replay tool
+//   replay generate <file> [ticks] [symbols]   synthetic random-walk session
+//   replay run [--speed X] <file>...            replay into a MarketDataHandler
+// Replays are deterministic, so the same files drive benchmarks and profile-guided builds.
+
+namespace {
+
+void generate(const std::string& path, uint64_t ticks, size_t symbol_count) {
+    std::mt19937_64 rng(42);
+    std::normal_distribution<double> step(0.0, 1.0);
+    std::uniform_int_distribution<uint64_t> size(1, 10);
+    std::uniform_int_distribution<int> trade_odds(0, 9);
+
+    std::vector<SymbolId> ids;
+    std::vector<double> mids;
+    for (size_t i = 0; i < symbol_count; ++i) {
+        ids.push_back(symbols().add("SYN" + std::to_string(i), 0.01));
+        mids.push_back(10000.0 + 500.0 * static_cast<double>(i));  // In ticks
+    }
+
+    TickJournalWriter journal(path, ticks);
+    int64_t ts = 34200ll * 1000000000ll;  // 09:30 in nanoseconds since midnight
+    for (uint64_t n = 0; n < ticks; ++n) {
+        size_t i = n % symbol_count;
+        ts += 1000 + static_cast<int64_t>(size(rng) * 100);
+        mids[i] = std::max(1.0, mids[i] + step(rng));
+        Price mid = std::llround(mids[i]);
+
+        if (trade_odds(rng) == 0) {
+            Trade trade;
+            trade.symbol = ids[i];
+            trade.is_buy = (n & 1u) != 0;
+            trade.price = trade.is_buy ? mid + 1 : mid - 1;
+            trade.quantity = size(rng) * 100;
+            trade.timestamp = std::chrono::nanoseconds(ts);
+            journal.append(trade);
+        } else {
+            Quote quote;
+            quote.symbol = ids[i];
+            quote.bid = mid - 1;
+            quote.ask = mid + 1;
+            quote.bid_size = size(rng) * 100;
+            quote.ask_size = size(rng) * 100;
+            quote.timestamp = std::chrono::nanoseconds(ts);
+            journal.append(quote);
+        }
+    }
+    std::cout << "Wrote " << journal.size() << " ticks for " << symbol_count << " symbols to " << path << std::endl;
+}
+
+void run(const std::vector<std::string>& paths, double speed) {
+    TickReplayer replayer;
+    for (const auto& path : paths) {
+        replayer.add_file(path);
+    }
+
+    MarketDataHandler market_data;
+    for (SymbolId id : replayer.replay_symbols()) {
+        market_data.add_symbol(id);
+    }
+    market_data.start();
+
+    auto pacing = speed > 0 ? ReplayPacing::WallClock : ReplayPacing::AsFastAsPossible;
+    int64_t start = LatencyClock::now_ns();
+    uint64_t replayed = replayer.replay(market_data, pacing, speed);
+
+    // Stop only once the shards have applied everything
+    auto applied = [&market_data]() {
+        uint64_t total = 0;
+        for (size_t shard = 0; shard < market_data.shard_count(); ++shard) {
+            total += market_data.shard_updates(shard);
+        }
+        return total;
+    };
+    while (applied() < replayed) {
+        cpu_relax();
+    }
+    int64_t elapsed = LatencyClock::now_ns() - start;
+    market_data.stop();
+
+    double seconds = static_cast<double>(elapsed) / 1e9;
+    std::cout << "Replayed " << replayed << " ticks from " << paths.size() << " file(s) in "
+              << seconds << "s (" << static_cast<double>(replayed) / seconds << " ticks/s, "
+              << replayer.retries() << " retries)" << std::endl;
+    LatencyRegistry::instance().report(std::cout);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    try {
+        std::vector<std::string> args(argv + 1, argv + argc);
+        if (args.size() >= 2 && args[0] == "generate") {
+            uint64_t ticks = args.size() > 2 ? std::stoull(args[2]) : 1000000;
+            size_t symbol_count = args.size() > 3 ? std::stoul(args[3]) : 8;
+            generate(args[1], ticks, std::max<size_t>(1, symbol_count));
+            return 0;
+        }
+        if (args.size() >= 2 && args[0] == "run") {
+            double speed = 0;  // As fast as possible
+            std::vector<std::string> paths;
+            for (size_t i = 1; i < args.size(); ++i) {
+                if (args[i] == "--speed" && i + 1 < args.size()) {
+                    speed = std::stod(args[++i]);
+                } else {
+                    paths.push_back(args[i]);
+                }
+            }
+            run(paths, speed);
+            return 0;
+        }
+        std::cerr << "usage: replay generate <file> [ticks] [symbols]\n"
+                  << "       replay run [--speed X] <file>..." << std::endl;
+        return 2;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,227 @@
+#include "controlplane"
+#include "journal"
+#include "metrics"
+#include "mmcomp"
+#include "riskmgmt"
+#include "venue"
+
+// Closed-loop simulation against the simulated venue
+//   simulate [seconds] [symbols] [venue_shards] [latency_us] [queue_ahead] [control_socket] [journal]
+//            [metrics_port]
+// Background flow trades on its own venue session. A tape thread turns venue books into market
+// data, MarketMaker quotes through OrderManager and a second session, and fills flow back into
+// RiskManager, AdvancedRiskManager and the maker's inventory. With a control socket, maker
+// parameters and AdvancedRiskManager limits can be changed live, e.g.
+//   echo "quote SIM0 spread_percentage=0.001 levels=5" | nc -U <control_socket>
+// With a journal, fills and order state are journaled (text log at <journal>.log), and a rerun
+// with the same journal resumes the positions the last run ended with. With a metrics port,
+// queue depths, drops, rejects and pool use are served at http://127.0.0.1:<port>/metrics and
+// mirrored into the shared memory object /llsys-simulate.
+
+namespace {
+
+struct FillCounter {
+    std::atomic<uint64_t> fills{0};
+    std::atomic<uint64_t> quantity{0};
+
+    void on_fill(const Trade& fill) {
+        fills.fetch_add(1, std::memory_order_relaxed);
+        quantity.fetch_add(fill.quantity, std::memory_order_relaxed);
+    }
+};
+
+// Random limit orders around a drifting price, with old orders cancelled to bound the book
+void run_flow(VenueSession& session, const std::vector<SymbolId>& ids, std::atomic<bool>& running,
+              std::atomic<uint64_t>& sent) {
+    static constexpr size_t OUTSTANDING = 4096;
+    pin_current_thread(-1, "sim-flow");
+    std::mt19937_64 rng(7);
+    std::uniform_int_distribution<int> offset(-8, 8);
+    std::uniform_int_distribution<size_t> quantity(1, 10);
+    std::vector<Price> mids(ids.size(), 10000);
+    std::vector<Order> outstanding(OUTSTANDING);
+    uint64_t next_id = 1;
+    auto drain = [](const ExecutionReport&) {};
+
+    while (running.load(std::memory_order_relaxed)) {
+        size_t i = static_cast<size_t>(next_id % ids.size());
+        mids[i] += offset(rng) / 8;
+
+        Order& slot = outstanding[next_id % OUTSTANDING];
+        if (slot.order_id != 0 && !session.send(OrderRequestType::Cancel, slot)) {
+            session.poll(drain);
+            continue;
+        }
+        Order order;
+        order.order_id = next_id;
+        order.symbol = ids[i];
+        order.is_buy = (rng() & 1) != 0;
+        order.price = mids[i] + offset(rng);
+        order.quantity = quantity(rng) * 100;
+        if (!session.send(OrderRequestType::New, order)) {
+            session.poll(drain);
+            continue;
+        }
+        slot = order;
+        ++next_id;
+        sent.fetch_add(2, std::memory_order_relaxed);
+        session.poll(drain);
+    }
+}
+
+// Publishes each venue book's top of book into the market data handler when it changes
+void run_tape(const SimulatedVenue& venue, MarketDataHandler& market_data, const std::vector<SymbolId>& ids,
+              std::atomic<bool>& running) {
+    pin_current_thread(-1, "sim-tape");
+    std::vector<uint64_t> seen(ids.size(), 0);
+    while (running.load(std::memory_order_relaxed)) {
+        for (size_t i = 0; i < ids.size(); ++i) {
+            TopOfBook top = venue.book(ids[i])->top_of_book();
+            if (top.sequence == seen[i] || top.bid == 0 || top.ask == 0) {
+                continue;
+            }
+            seen[i] = top.sequence;
+            Quote quote;
+            quote.symbol = ids[i];
+            quote.bid = top.bid;
+            quote.ask = top.ask;
+            quote.bid_size = top.bid_size;
+            quote.ask_size = top.ask_size;
+            quote.timestamp = get_current_timestamp();
+            if (!market_data.on_quote(quote)) {
+                seen[i] = 0;  // Retry on the next pass
+            }
+        }
+        cpu_relax();
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    try {
+        int seconds = argc > 1 ? std::atoi(argv[1]) : 5;
+        size_t symbol_count = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 4;
+        VenueConfig venue_config;
+        venue_config.num_shards = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 2;
+        venue_config.inbound_latency = venue_config.outbound_latency =
+            std::chrono::microseconds(argc > 4 ? std::atoi(argv[4]) : 0);
+        venue_config.queue_ahead = argc > 5 ? std::atof(argv[5]) : 0.0;
+        ControlPlaneConfig control_config;
+        control_config.socket_path = argc > 6 ? argv[6] : "";
+        std::string journal_path = argc > 7 ? argv[7] : "";
+        MetricsExporterConfig metrics_config;
+        metrics_config.interval = std::chrono::milliseconds(250);
+        metrics_config.http_port = static_cast<uint16_t>(argc > 8 ? std::atoi(argv[8]) : 0);
+        if (metrics_config.http_port != 0) {
+            metrics_config.shm_name = "/llsys-simulate";
+        }
+
+        std::vector<SymbolId> ids;
+        SimulatedVenue venue(venue_config);
+        MarketDataHandler market_data;
+        RiskManager risk_manager;
+        OrderManager order_manager(risk_manager);
+        AdvancedRiskManager advanced_risk;
+        MarketMaker maker(market_data, order_manager, risk_manager);
+        FillCounter maker_fills;
+        ControlPlane control_plane(control_config);
+        MetricsExporter metrics(metrics_config);
+
+        for (size_t i = 0; i < std::max<size_t>(1, symbol_count); ++i) {
+            SymbolId id = symbols().add("SIM" + std::to_string(i), 0.01);
+            ids.push_back(id);
+            venue.add_symbol(id, 10000);
+            market_data.add_symbol(id, 10000);
+            market_data.subscribe(id, advanced_risk);
+            risk_manager.set_position_limit(id, 1e6, 1e12);
+            maker.configure_symbol(id, 0.0005, 200, 0.1, 0.01, 3, 0.5);
+        }
+        std::unique_ptr<OrderJournal> journal;
+        if (!journal_path.empty()) {
+            if (!AsyncLogger::instance().start(journal_path + ".log")) {
+                throw std::runtime_error("Cannot open log file " + journal_path + ".log");
+            }
+            journal = std::make_unique<OrderJournal>(OrderJournalConfig{journal_path});
+            const OrderLedger& recovered = journal->ledger();
+            recovered.restore_positions(risk_manager);
+            recovered.restore_positions(advanced_risk);
+            recovered.restore_order_ids(maker);
+            // The venue starts empty, so orders open at the last shutdown are gone: closed, not resumed
+            size_t abandoned = journal->close_open_orders();
+            std::cout << "journal: recovered sequence " << recovered.sequence() << " (" << journal->replayed()
+                      << " entries replayed) in " << static_cast<double>(journal->recovery_ns()) / 1e6 << " ms, "
+                      << journal->check_positions(risk_manager) << " position mismatches, "
+                      << abandoned << " orders open at last shutdown closed\n";
+            journal->attach();
+        }
+        VenueSession& flow_session = venue.connect();
+        VenueSession& maker_session = venue.connect();
+        order_manager.attach_gateway(maker_session);
+        order_manager.subscribe_fills(advanced_risk);
+        order_manager.subscribe_fills(maker_fills);
+        control_plane.attach_maker(maker);
+        control_plane.attach_risk(advanced_risk);
+
+        venue.start();
+        market_data.start();
+        order_manager.start();
+        control_plane.start();
+        if (metrics_config.http_port != 0) {
+            metrics.start();
+        }
+
+        std::atomic<bool> running{true};
+        std::atomic<uint64_t> flow_sent{0};
+        std::thread flow([&]() { run_flow(flow_session, ids, running, flow_sent); });
+        std::thread tape([&]() { run_tape(venue, market_data, ids, running); });
+
+        int64_t start = LatencyClock::now_ns();
+        std::this_thread::sleep_for(std::chrono::seconds(seconds));
+        running = false;
+        flow.join();
+        tape.join();
+        int64_t elapsed = LatencyClock::now_ns() - start;
+
+        control_plane.stop();
+        order_manager.stop();
+        market_data.stop();
+        venue.stop();
+        metrics.stop();
+        if (journal) {
+            journal->close();
+        }
+
+        double secs = static_cast<double>(elapsed) / 1e9;
+        std::cout << "venue: " << venue.requests_processed() << " requests ("
+                  << static_cast<double>(venue.requests_processed()) / secs / 1e6 << "M/s), "
+                  << venue.executions() << " executions\n"
+                  << "flow: " << flow_sent.load() << " messages sent\n"
+                  << "maker: " << maker_fills.fills.load() << " fills, " << maker_fills.quantity.load()
+                  << " shares, " << order_manager.live_orders() << " live orders\n";
+        for (SymbolId id : ids) {
+            std::cout << "  " << symbols().name(id) << " position " << risk_manager.position(id) << "\n";
+        }
+        if (journal) {
+            std::cout << "journal: " << journal->sequence() << " entries, " << journal->snapshots()
+                      << " snapshots, " << journal->check_positions(risk_manager) << " position mismatches, "
+                      << AsyncLogger::instance().journal_dropped() << " dropped\n";
+            AsyncLogger::instance().stop();
+        }
+        if (metrics_config.http_port != 0) {
+            MetricsRegistry& registry = MetricsRegistry::instance();
+            uint64_t risk_rejects = 0;
+            for (size_t i = 0; i < static_cast<size_t>(RiskReject::COUNT); ++i) {
+                risk_rejects += registry.counter(risk_reject_metric(static_cast<RiskReject>(i)));
+            }
+            std::cout << "metrics: " << metrics.samples() << " samples, " << metrics.scrapes() << " scrapes, "
+                      << risk_rejects << " risk rejects, " << registry.counter(Metric::MarketDataQueueFull)
+                      << " market data queue full, " << registry.counter(Metric::GatewayFull) << " gateway full\n";
+        }
+        LatencyRegistry::instance().report(std::cout);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,330 +1,194 @@
-#include <atomic>
-#include <chrono>
-#include <condition_variable>
-#include <deque>
-#include <iostream>
-#include <mutex>
-#include <string>
-#include <thread>
-#include <unordered_map>
-#include <vector>
-
-// Forward declarations
-class OrderBook;
-class MarketDataHandler;
-class OrderManager;
-class RiskManager;
-class Strategy;
-
-// Custom memory allocator for low latency
-template<typename T>
-class LockFreeAllocator {
+#include <tuple>
+#include "common.hpp"
+#include "journal"
+#include "metrics"
+
+// Risk policy for this deployment, fixed at compile time (LLSYS_RISK_POLICY in CMake)
+#ifdef LLSYS_ADVANCED_RISK
+#include "riskmgmt"
+using DeploymentRisk = AdvancedRiskManager;
+#else
+using DeploymentRisk = RiskManager;
+#endif
+
+template<typename OrderManagerType = OrderManager>
+class Strategy : public StrategyBase<Strategy<OrderManagerType>, OrderManagerType> {
 private:
-    static constexpr size_t POOL_SIZE = 1024;
-    std::array<T, POOL_SIZE> pool_;
-    std::atomic<size_t> next_free_{0};
+    using Base = StrategyBase<Strategy, OrderManagerType>;
+
+    SymbolId symbol_;
 
 public:
-    T* allocate() {
-        size_t index = next_free_.fetch_add(1, std::memory_order_relaxed);
-        if (index >= POOL_SIZE) {
-            throw std::runtime_error("Pool exhausted");
-        }
-        return &pool_[index];
+    // Must be constructed before market data starts: it subscribes to its symbol
+    Strategy(MarketDataHandler& md, OrderManagerType& om, SymbolId symbol,
+             DispatchMode dispatch_mode = DispatchMode::Queued,
+             WaitMode wait_mode = WaitMode::Park)
+        : Base(md, om, dispatch_mode, wait_mode), symbol_(symbol) {
+        this->subscribe(symbol_);
     }
 
-    void deallocate(T* ptr) {
-        // Simple implementation - in production, would need proper memory recycling
-    }
-};
+    void on_quote(const Quote&) {}
 
-// Market data structures
-struct Quote {
-    std::string symbol;
-    double bid;
-    double ask;
-    size_t bid_size;
-    size_t ask_size;
-    std::chrono::nanoseconds timestamp;
-};
+    void on_trade(const Trade&) {}
 
-struct Trade {
-    std::string symbol;
-    double price;
-    size_t quantity;
-    bool is_buy;
-    std::chrono::nanoseconds timestamp;
+    void on_book_update(SymbolId, const TopOfBook&) {
+        // Implementation of trading logic
+        // This is where you would implement your specific trading strategy
+    }
 };
 
-// Order structures
-struct Order {
-    std::string order_id;
-    std::string symbol;
-    double price;
-    size_t quantity;
-    bool is_buy;
-    std::chrono::nanoseconds timestamp;
-    std::string status;  // "NEW", "FILLED", "CANCELLED", "REJECTED"
+struct TradingSystemConfig {
+    MarketDataConfig market_data;
+    WaitMode order_wait_mode = WaitMode::BusySpin;
+    DispatchMode strategy_dispatch = DispatchMode::Queued;
+    WaitMode strategy_wait_mode = WaitMode::Park;
+    std::chrono::seconds latency_report_interval{0};  // 0 disables periodic reports
+    std::string log_path = "trading.log";
+    std::string journal_path;  // Order journal for warm restarts; empty disables it
+    MetricsExporterConfig metrics;  // Exported when it has an HTTP port or a shm name
 };
 
-// Lock-free queue for inter-thread communication
-template<typename T>
-class LockFreeQueue {
+// Main trading system
+// The risk policy and the set of strategy types are template parameters, so the path from a
+// market data callback through the risk check has no indirect calls. Strategies are held per
+// type; each strategy template is instantiated with this system's order manager.
+template<typename RiskPolicy, template<typename> class... Strategies>
+class TradingSystem {
 private:
-    static constexpr size_t QUEUE_SIZE = 1024;
-    std::array<T, QUEUE_SIZE> buffer_;
-    std::atomic<size_t> head_{0};
-    std::atomic<size_t> tail_{0};
+    using OrderManagerType = BasicOrderManager<RiskPolicy>;
+
+    TradingSystemConfig config_;
+    MarketDataHandler market_data_;
+    RiskPolicy risk_manager_;
+    OrderManagerType order_manager_;
+    std::tuple<std::vector<std::unique_ptr<Strategies<OrderManagerType>>>...> strategies_;
+    std::unique_ptr<OrderJournal> journal_;
+    std::unique_ptr<MetricsExporter> metrics_;
+
+    // Periodic latency reporting, off the hot threads
+    std::thread reporter_thread_;
+    std::mutex reporter_mutex_;
+    std::condition_variable reporter_cv_;
+    bool reporter_stop_ = false;
+    bool started_ = false;
 
 public:
-    bool push(const T& item) {
-        size_t current_tail = tail_.load(std::memory_order_relaxed);
-        size_t next_tail = (current_tail + 1) % QUEUE_SIZE;
-        
-        if (next_tail == head_.load(std::memory_order_acquire)) {
-            return false;  // Queue is full
-        }
-        
-        buffer_[current_tail] = item;
-        tail_.store(next_tail, std::memory_order_release);
-        return true;
-    }
+    explicit TradingSystem(const TradingSystemConfig& config = {})
+        : config_(config), market_data_(config.market_data),
+          order_manager_(risk_manager_, config.order_wait_mode) {}
 
-    bool pop(T& item) {
-        size_t current_head = head_.load(std::memory_order_relaxed);
-        
-        if (current_head == tail_.load(std::memory_order_acquire)) {
-            return false;  // Queue is empty
-        }
-        
-        item = buffer_[current_head];
-        head_.store((current_head + 1) % QUEUE_SIZE, std::memory_order_release);
-        return true;
+    // Strategies must not outlive their threads, including on exception paths
+    ~TradingSystem() {
+        stop();
     }
-};
-
-// Order book implementation
-class OrderBook {
-private:
-    struct Level {
-        double price;
-        size_t quantity;
-        std::vector<Order*> orders;
-    };
-
-    std::string symbol_;
-    std::vector<Level> bids_;
-    std::vector<Level> asks_;
-    std::mutex book_mutex_;
 
-public:
-    explicit OrderBook(const std::string& symbol) : symbol_(symbol) {}
+    TradingSystem(const TradingSystem&) = delete;
+    TradingSystem& operator=(const TradingSystem&) = delete;
 
-    void update(const Quote& quote) {
-        std::lock_guard<std::mutex> lock(book_mutex_);
-        // Update bid and ask levels
-        // In production, would use more sophisticated data structures
-    }
+    // For configuring limits before start()
+    RiskPolicy& risk_manager() { return risk_manager_; }
 
-    Quote get_top_of_book() const {
-        std::lock_guard<std::mutex> lock(book_mutex_);
-        // Return best bid and ask
-        return Quote{};  // Simplified
+    size_t strategy_count() const {
+        return std::apply([](const auto&... group) { return (size_t{0} + ... + group.size()); }, strategies_);
     }
-};
-
-// Market data handler
-class MarketDataHandler {
-private:
-    LockFreeQueue<Quote> quote_queue_;
-    std::unordered_map<std::string, OrderBook> order_books_;
-    std::thread processing_thread_;
-    std::atomic<bool> running_{true};
 
-public:
-    void start() {
-        processing_thread_ = std::thread([this]() {
-            while (running_) {
-                Quote quote;
-                if (quote_queue_.pop(quote)) {
-                    process_quote(quote);
+    template<typename Fn>
+    void for_each_strategy(Fn&& fn) {
+        std::apply([&fn](auto&... group) {
+            (..., [&fn, &group] {
+                for (auto& strategy : group) {
+                    fn(*strategy);
                 }
-            }
-        });
+            }());
+        }, strategies_);
     }
 
-    void stop() {
-        running_ = false;
-        if (processing_thread_.joinable()) {
-            processing_thread_.join();
+    void start() {
+        if (started_) {
+            return;
         }
-    }
-
-    void on_quote(const Quote& quote) {
-        quote_queue_.push(quote);
-    }
-
-private:
-    void process_quote(const Quote& quote) {
-        auto it = order_books_.find(quote.symbol);
-        if (it != order_books_.end()) {
-            it->second.update(quote);
+        started_ = true;
+        if (!AsyncLogger::instance().start(config_.log_path)) {
+            throw std::runtime_error("Cannot open log file " + config_.log_path);
         }
-    }
-};
-
-// Risk manager
-class RiskManager {
-private:
-    struct PositionLimit {
-        double max_position;
-        double max_dollar_exposure;
-    };
-
-    std::unordered_map<std::string, PositionLimit> position_limits_;
-    std::unordered_map<std::string, double> current_positions_;
-    std::mutex position_mutex_;
-
-public:
-    bool check_order(const Order& order) {
-        std::lock_guard<std::mutex> lock(position_mutex_);
-        
-        auto it = position_limits_.find(order.symbol);
-        if (it == position_limits_.end()) {
-            return false;
+        if (!config_.journal_path.empty()) {
+            // Positions and working orders from the last run before any order can be checked
+            // against them; the restored orders hold their reservations again
+            journal_ = std::make_unique<OrderJournal>(OrderJournalConfig{config_.journal_path});
+            journal_->ledger().restore_positions(risk_manager_);
+            journal_->ledger().restore_orders(order_manager_);
+            journal_->attach();
         }
-
-        double new_position = current_positions_[order.symbol];
-        if (order.is_buy) {
-            new_position += order.quantity;
-        } else {
-            new_position -= order.quantity;
+        // Downstream first, so nothing reaches a component that is not running yet
+        order_manager_.start();
+        for_each_strategy([](auto& strategy) { strategy.start(); });
+        market_data_.start();
+        if (config_.metrics.http_port != 0 || !config_.metrics.shm_name.empty()) {
+            metrics_ = std::make_unique<MetricsExporter>(config_.metrics);
+            metrics_->start();
         }
-
-        return std::abs(new_position) <= it->second.max_position;
-    }
-};
-
-// Order manager
-class OrderManager {
-private:
-    LockFreeQueue<Order> order_queue_;
-    RiskManager& risk_manager_;
-    std::thread processing_thread_;
-    std::atomic<bool> running_{true};
-
-public:
-    explicit OrderManager(RiskManager& risk_manager) : risk_manager_(risk_manager) {}
-
-    void start() {
-        processing_thread_ = std::thread([this]() {
-            while (running_) {
-                Order order;
-                if (order_queue_.pop(order)) {
-                    process_order(order);
+        log_event(LogFormat::SystemStarted, market_data_.shard_count(), strategy_count());
+
+        if (config_.latency_report_interval.count() > 0) {
+            reporter_thread_ = std::thread([this]() {
+                std::unique_lock<std::mutex> lock(reporter_mutex_);
+                while (!reporter_cv_.wait_for(lock, config_.latency_report_interval,
+                                              [this] { return reporter_stop_; })) {
+                    LatencyRegistry::instance().report(std::cout);
                 }
-            }
-        });
+            });
+        }
     }
 
+    // Upstream first: Inline strategies run on the shard threads and submit orders from there
     void stop() {
-        running_ = false;
-        if (processing_thread_.joinable()) {
-            processing_thread_.join();
+        if (!started_) {
+            return;
         }
-    }
-
-    void submit_order(const Order& order) {
-        if (risk_manager_.check_order(order)) {
-            order_queue_.push(order);
+        started_ = false;
+        market_data_.stop();
+        for_each_strategy([](auto& strategy) { strategy.stop(); });
+        order_manager_.stop();
+        if (journal_) {
+            journal_->close();
         }
-    }
-
-private:
-    void process_order(const Order& order) {
-        // Implementation would connect to exchange/broker API
-        std::cout << "Processing order: " << order.order_id << std::endl;
-    }
-};
-
-// Trading strategy
-class Strategy {
-private:
-    MarketDataHandler& market_data_;
-    OrderManager& order_manager_;
-    std::string symbol_;
-    std::atomic<bool> running_{true};
-    std::thread strategy_thread_;
-
-public:
-    Strategy(MarketDataHandler& md, OrderManager& om, const std::string& symbol)
-        : market_data_(md), order_manager_(om), symbol_(symbol) {}
-
-    void start() {
-        strategy_thread_ = std::thread([this]() {
-            while (running_) {
-                process_market_data();
-                std::this_thread::sleep_for(std::chrono::milliseconds(1));
-            }
-        });
-    }
-
-    void stop() {
-        running_ = false;
-        if (strategy_thread_.joinable()) {
-            strategy_thread_.join();
+        if (metrics_) {
+            metrics_->stop();
         }
-    }
-
-private:
-    void process_market_data() {
-        // Implementation of trading logic
-        // This is where you would implement your specific trading strategy
-    }
-};
 
-// Main trading system
-class TradingSystem {
-private:
-    MarketDataHandler market_data_;
-    RiskManager risk_manager_;
-    OrderManager order_manager_;
-    std::vector<std::unique_ptr<Strategy>> strategies_;
-
-public:
-    TradingSystem() : order_manager_(risk_manager_) {}
-
-    void start() {
-        market_data_.start();
-        order_manager_.start();
-        
-        for (auto& strategy : strategies_) {
-            strategy->start();
+        {
+            std::lock_guard<std::mutex> lock(reporter_mutex_);
+            reporter_stop_ = true;
         }
-    }
-
-    void stop() {
-        for (auto& strategy : strategies_) {
-            strategy->stop();
+        reporter_cv_.notify_all();
+        if (reporter_thread_.joinable()) {
+            reporter_thread_.join();
         }
-        
-        order_manager_.stop();
-        market_data_.stop();
+        LatencyRegistry::instance().report(std::cout);
+        log_event(LogFormat::SystemStopped);
+        AsyncLogger::instance().stop();
     }
 
-    void add_strategy(const std::string& symbol) {
-        strategies_.push_back(std::make_unique<Strategy>(
-            market_data_, order_manager_, symbol));
+    template<template<typename> class S>
+    void add_strategy(const std::string& symbol, double tick_size = 0.01) {
+        SymbolId id = symbols().add(symbol, tick_size);
+        market_data_.add_symbol(id);
+        if constexpr (requires { risk_manager_.on_book_update(id, TopOfBook{}); }) {
+            market_data_.subscribe(id, risk_manager_);
+        }
+        std::get<std::vector<std::unique_ptr<S<OrderManagerType>>>>(strategies_).push_back(
+            std::make_unique<S<OrderManagerType>>(market_data_, order_manager_, id,
+                                                  config_.strategy_dispatch, config_.strategy_wait_mode));
     }
 };
 
 int main() {
     try {
-        TradingSystem trading_system;
+        TradingSystem<DeploymentRisk, Strategy> trading_system;
         
         // Add trading strategies
-        trading_system.add_strategy("AAPL");
-        trading_system.add_strategy("GOOGL");
+        trading_system.add_strategy<Strategy>("AAPL");
+        trading_system.add_strategy<Strategy>("GOOGL");
         
         // Start the system
         trading_system.start();
@@ -0,0 +1,133 @@
+#include <future>
+#include <optional>
+#include "controlplane"
+#include "tests/test.hpp"
+
+// Control plane command validation: what is published, and what is refused before it can be
+
+namespace {
+
+struct Limits {
+    double max_gross_position = 0;
+    double max_net_position = 0;
+    double max_dollar_exposure = 0;
+    double var_limit = 0;
+    double es_limit = 0;
+    double max_drawdown_limit = 0;
+    std::chrono::nanoseconds max_position_duration{0};
+    double max_order_size = 0;
+    double max_daily_loss = 0;
+    size_t max_daily_trades = 0;
+};
+
+struct FakeRisk {
+    using RiskLimits = Limits;
+    std::optional<Limits> current;
+    size_t published = 0;
+
+    std::optional<Limits> risk_limits(SymbolId) const { return current; }
+    void set_risk_limits(SymbolId, const Limits& limits) {
+        current = limits;
+        ++published;
+    }
+};
+
+struct Params {
+    double spread_percentage;
+    double base_position_size;
+    double inventory_skew_factor;
+    Price tick_increment;
+    size_t levels;
+    double level_spacing;
+    bool enabled;
+};
+
+struct FakeMaker {
+    Params current{0.001, 100.0, 0.1, 1, 3, 0.5, true};
+    size_t published = 0;
+
+    std::optional<Params> params(SymbolId) const { return current; }
+    void configure_symbol(SymbolId, const Params& params) {
+        current = params;
+        ++published;
+    }
+};
+
+// A control plane with both handlers, applying one command at a time
+struct Rig {
+    FakeRisk risk;
+    FakeMaker maker;
+    ControlPlane control;
+
+    Rig() {
+        symbols().add("CTRL", 0.01);
+        control.attach_risk(risk);
+        control.attach_maker(maker);
+        control.start();
+    }
+
+    ~Rig() { control.stop(); }
+
+    // True if the command was applied, false if refused. Updates run in order on the control
+    // thread, so once the barrier behind the command has run, its effects are visible here.
+    bool command(const std::string& line) {
+        uint64_t applied = control.applied();
+        control.submit_command(line);
+        std::promise<void> done;
+        control.submit([&done]() { done.set_value(); });
+        done.get_future().wait();
+        return control.applied() > applied;
+    }
+};
+
+}  // namespace
+
+TEST(in_range_fields_are_published) {
+    Rig rig;
+    CHECK(rig.command("limits CTRL max_net_position=500 max_daily_trades=100 max_position_duration_ms=60000"));
+    CHECK(rig.risk.published == 1);
+    CHECK(rig.risk.current->max_net_position == 500);
+    CHECK(rig.risk.current->max_daily_trades == 100);
+    CHECK(rig.risk.current->max_position_duration == std::chrono::milliseconds(60000));
+    CHECK(rig.command("quote CTRL spread_percentage=0.002 levels=4 tick_increment=5 enabled=0"));
+    CHECK(rig.maker.published == 1);
+    CHECK(rig.maker.current.levels == 4);
+    CHECK(rig.maker.current.tick_increment == 5);
+    CHECK(!rig.maker.current.enabled);
+}
+
+TEST(out_of_range_limits_publish_nothing) {
+    Rig rig;
+    for (const char* line : {"limits CTRL max_daily_trades=-1", "limits CTRL max_daily_trades=2.5",
+                             "limits CTRL max_net_position=-10", "limits CTRL max_order_size=100 var_limit=-1",
+                             "limits CTRL max_position_duration_ms=1e300", "limits CTRL max_daily_trades=1e30"}) {
+        CHECK(!rig.command(line));
+    }
+    CHECK(rig.risk.published == 0);
+    CHECK(rig.control.rejected() == 6);
+}
+
+TEST(out_of_range_quote_params_publish_nothing) {
+    Rig rig;
+    for (const char* line : {"quote CTRL levels=-1", "quote CTRL base_position_size=0",
+                             "quote CTRL spread_percentage=-0.001", "quote CTRL spread_percentage=0",
+                             "quote CTRL tick_increment=0", "quote CTRL level_spacing=-0.5",
+                             "quote CTRL enabled=2", "quote CTRL levels=2 base_position_size=-5",
+                             "quote CTRL spread_percentage=0.2 levels=16 level_spacing=1"}) {  // Deepest bid below 0
+        CHECK(!rig.command(line));
+    }
+    CHECK(rig.maker.published == 0);
+    CHECK(rig.maker.current.levels == 3);
+    CHECK(rig.maker.current.base_position_size == 100.0);
+}
+
+TEST(unknown_fields_are_still_reported_as_such) {
+    Rig rig;
+    CHECK(!rig.command("limits CTRL max_leverage=-1"));
+    CHECK(!rig.command("quote CTRL nonsense=1"));
+    CHECK(rig.risk.published == 0 && rig.maker.published == 0);
+}
+
+int main() {
+    return llsys_test::run_all();
+}
@@ -0,0 +1,213 @@
+#include "feedhandler"
+#include "tests/test.hpp"
+
+// Feed sequencing, A/B arbitration and gap handling, driven through on_packet() without sockets.
+// Every message is a quote whose bid is its own sequence number, so the sink sees what was
+// delivered and in what order.
+
+namespace {
+
+struct RecordingSink {
+    std::vector<Price> delivered;
+    size_t refusals = 0;  // Leading on_quote calls to refuse, to exercise the retry
+
+    bool on_quote(const Quote& quote) {
+        if (refusals > 0) {
+            --refusals;
+            return false;
+        }
+        delivered.push_back(quote.bid);
+        return true;
+    }
+
+    bool on_trade(const Trade&) { return true; }
+};
+
+// Messages [sequence, sequence + count); count 0 is a heartbeat
+std::vector<unsigned char> packet(uint64_t sequence, uint16_t count) {
+    using namespace feed_wire;
+    std::vector<unsigned char> data(sizeof(PacketHeader) + count * sizeof(QuoteMessage));
+    PacketHeader header{sequence, count, {}};
+    std::memcpy(data.data(), &header, sizeof(header));
+    for (uint16_t i = 0; i < count; ++i) {
+        QuoteMessage message{};
+        message.header = MessageHeader{sizeof(QuoteMessage), QuoteUpdate, 0};
+        message.instrument = 0;
+        message.bid = static_cast<int64_t>(sequence + i);
+        message.ask = message.bid + 1;
+        std::memcpy(data.data() + sizeof(PacketHeader) + i * sizeof(QuoteMessage), &message, sizeof(message));
+    }
+    return data;
+}
+
+template<typename Feed>
+void receive(Feed& feed, int line, uint64_t sequence, uint16_t count) {
+    std::vector<unsigned char> data = packet(sequence, count);
+    feed.on_packet(line, data.data(), data.size());
+}
+
+// Both ports set turns arbitration on; the lines are never opened because start() is not called
+FeedConfig arbitrated_config() {
+    FeedConfig config;
+    config.line_a.port = 1;
+    config.line_b.port = 2;
+    return config;
+}
+
+std::vector<Price> range(Price first, Price last) {
+    std::vector<Price> values;
+    for (Price p = first; p <= last; ++p) {
+        values.push_back(p);
+    }
+    return values;
+}
+
+}  // namespace
+
+TEST(single_line_declares_gap_immediately) {
+    RecordingSink sink;
+    FeedHandler<RecordingSink> feed(sink, FeedConfig{});
+    SymbolId symbol = symbols().add("FEED", 0.01);
+    feed.map_instrument(0, symbol);
+
+    receive(feed, 0, 1, 3);  // 1-3
+    receive(feed, 0, 7, 2);  // 4-6 lost
+    CHECK(sink.delivered == (std::vector<Price>{1, 2, 3, 7, 8}));
+    CHECK(feed.stats().gaps == 1);
+    CHECK(feed.stats().lost_messages == 3);
+    CHECK(feed.next_sequence() == 9);
+}
+
+TEST(duplicates_from_either_line_are_dropped) {
+    RecordingSink sink;
+    FeedHandler<RecordingSink> feed(sink, arbitrated_config());
+    feed.map_instrument(0, symbols().add("FEED", 0.01));
+
+    receive(feed, 0, 1, 4);  // A: 1-4
+    receive(feed, 1, 1, 4);  // B: same packet
+    receive(feed, 1, 5, 2);  // B first this time: 5-6
+    receive(feed, 0, 5, 2);
+    receive(feed, 0, 3, 4);  // 3-6, all delivered already
+    CHECK(sink.delivered == range(1, 6));
+    CHECK(feed.stats().duplicates == 3);
+    CHECK(feed.stats().gaps == 0);
+    CHECK(feed.stats().packets[0] == 3);
+    CHECK(feed.stats().packets[1] == 2);
+}
+
+TEST(overlapping_packet_delivers_only_its_new_messages) {
+    RecordingSink sink;
+    FeedHandler<RecordingSink> feed(sink, arbitrated_config());
+    feed.map_instrument(0, symbols().add("FEED", 0.01));
+
+    receive(feed, 0, 1, 4);  // 1-4
+    receive(feed, 1, 3, 4);  // 3-6: 5 and 6 are new
+    CHECK(sink.delivered == range(1, 6));
+    CHECK(feed.stats().duplicates == 0);
+}
+
+TEST(other_line_fills_a_gap_before_it_is_declared) {
+    RecordingSink sink;
+    FeedHandler<RecordingSink> feed(sink, arbitrated_config());
+    feed.map_instrument(0, symbols().add("FEED", 0.01));
+
+    receive(feed, 0, 1, 2);  // A: 1-2
+    receive(feed, 0, 5, 2);  // A: 5-6, ahead: parked
+    receive(feed, 0, 7, 1);  // A: 7, parked
+    CHECK(sink.delivered == range(1, 2));
+    receive(feed, 1, 3, 2);  // B: 3-4 fills the hole; the parked packets follow in order
+    CHECK(sink.delivered == range(1, 7));
+    CHECK(feed.stats().gaps == 0);
+    receive(feed, 1, 5, 2);  // B's copies of what A already delivered
+    receive(feed, 1, 7, 1);
+    CHECK(feed.stats().duplicates == 2);
+    CHECK(feed.next_sequence() == 8);
+}
+
+TEST(full_park_declares_the_gap) {
+    RecordingSink sink;
+    FeedHandler<RecordingSink> feed(sink, arbitrated_config());
+    feed.map_instrument(0, symbols().add("FEED", 0.01));
+
+    receive(feed, 0, 1, 1);
+    // Message 2 never arrives on either line; 64 later packets fill the park
+    for (uint64_t sequence = 3; sequence < 3 + 64; ++sequence) {
+        receive(feed, 0, sequence, 1);
+    }
+    CHECK(sink.delivered.size() == 1);
+    receive(feed, 0, 67, 1);  // No room to park: give up on 2
+    CHECK(feed.stats().gaps == 1);
+    CHECK(feed.stats().lost_messages == 1);
+    std::vector<Price> expected = range(3, 67);
+    expected.insert(expected.begin(), 1);
+    CHECK(sink.delivered == expected);
+}
+
+TEST(heartbeat_and_retry_keep_sequence) {
+    RecordingSink sink;
+    sink.refusals = 3;
+    FeedHandler<RecordingSink> feed(sink, FeedConfig{});
+    feed.map_instrument(0, symbols().add("FEED", 0.01));
+
+    receive(feed, 0, 1, 2);
+    receive(feed, 0, 3, 0);  // Heartbeat: next is 3, nothing missing
+    receive(feed, 0, 3, 1);
+    CHECK(sink.delivered == range(1, 3));
+    CHECK(feed.stats().sink_retries == 3);
+    CHECK(feed.stats().gaps == 0);
+    CHECK(feed.stats().duplicates == 0);
+}
+
+TEST(heartbeat_ahead_declares_the_lost_tail_on_timeout) {
+    RecordingSink sink;
+    FeedConfig config = arbitrated_config();
+    config.gap_timeout = std::chrono::microseconds(0);
+    FeedHandler<RecordingSink> feed(sink, config);
+    feed.map_instrument(0, symbols().add("FEED", 0.01));
+
+    receive(feed, 0, 1, 3);  // A: 1-3
+    receive(feed, 0, 7, 0);  // A: heartbeat, next is 7; 4-6 lost on A and never seen on B
+    CHECK(feed.stats().gaps == 0);
+    CHECK(feed.next_sequence() == 4);
+    feed.expire_gap();  // Quiet period: nothing parked, the heartbeat alone ends the gap
+    CHECK(feed.stats().gaps == 1);
+    CHECK(feed.stats().lost_messages == 3);
+    CHECK(feed.next_sequence() == 7);
+    feed.expire_gap();
+    CHECK(feed.stats().gaps == 1);
+    receive(feed, 1, 4, 3);  // B's late copy of the lost messages
+    receive(feed, 0, 7, 1);
+    CHECK(sink.delivered == (std::vector<Price>{1, 2, 3, 7}));
+    CHECK(feed.stats().duplicates == 1);
+}
+
+TEST(other_line_fills_a_heartbeat_gap_before_timeout) {
+    RecordingSink sink;
+    FeedConfig config = arbitrated_config();
+    config.gap_timeout = std::chrono::microseconds(0);
+    FeedHandler<RecordingSink> feed(sink, config);
+    feed.map_instrument(0, symbols().add("FEED", 0.01));
+
+    receive(feed, 0, 1, 3);  // A: 1-3
+    receive(feed, 0, 7, 0);  // A: heartbeat, next is 7
+    receive(feed, 1, 4, 3);  // B: 4-6 closes the gap
+    feed.expire_gap();
+    CHECK(sink.delivered == range(1, 6));
+    CHECK(feed.stats().gaps == 0);
+    CHECK(feed.next_sequence() == 7);
+}
+
+TEST(unknown_instrument_and_malformed_packets_are_counted) {
+    RecordingSink sink;
+    FeedHandler<RecordingSink> feed(sink, FeedConfig{});
+    std::vector<unsigned char> data = packet(1, 1);
+    feed.on_packet(0, data.data(), data.size());  // Instrument 0 not mapped
+    feed.on_packet(0, data.data(), 8);            // Shorter than a packet header
+    CHECK(sink.delivered.empty());
+    CHECK(feed.stats().unknown_instruments == 1);
+    CHECK(feed.stats().malformed == 1);
+}
+
+int main() {
+    return llsys_test::run_all();
+}
@@ -0,0 +1,182 @@
+#include "gateway"
+#include "tests/test.hpp"
+
+// Order gateway sequencing against a loopback venue socket. The outbound buffer is sized to hold
+// one message, so the second send of a burst finds it full until poll() flushes.
+
+namespace {
+
+// Listening loopback socket standing in for the venue; accepts the gateway's one connection
+struct LoopbackVenue {
+    int listener = -1;
+    int session = -1;
+    uint16_t port = 0;
+
+    LoopbackVenue() {
+        listener = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(addr);
+        if (::bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0 && ::listen(listener, 1) == 0 &&
+            ::getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &length) == 0) {
+            port = ntohs(addr.sin_port);
+        }
+    }
+
+    ~LoopbackVenue() {
+        if (session >= 0) {
+            ::close(session);
+        }
+        ::close(listener);
+    }
+
+    bool accept() {
+        session = ::accept(listener, nullptr, nullptr);
+        return session >= 0;
+    }
+
+    // Reads until the stream holds `bytes`, or a second passes
+    std::string read(size_t bytes) {
+        std::string data;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        char buffer[4096];
+        while (data.size() < bytes && std::chrono::steady_clock::now() < deadline) {
+            ssize_t n = ::recv(session, buffer, sizeof(buffer), MSG_DONTWAIT);
+            if (n > 0) {
+                data.append(buffer, static_cast<size_t>(n));
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        return data;
+    }
+
+    void write(const std::string& data) {
+        CHECK(::send(session, data.data(), data.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(data.size()));
+    }
+};
+
+GatewayConfig config(const LoopbackVenue& venue, WireProtocol protocol, size_t buffer_bytes) {
+    GatewayConfig c;
+    c.port = venue.port;
+    c.protocol = protocol;
+    c.busy_poll_us = 0;
+    c.buffer_bytes = buffer_bytes;
+    return c;
+}
+
+Order order(uint64_t order_id) {
+    Order o;
+    o.order_id = order_id;
+    o.symbol = symbols().add("GWAY", 0.01);
+    o.is_buy = true;
+    o.price = 10000;
+    o.quantity = 100;
+    return o;
+}
+
+// MsgSeqNum of every FIX message in the stream, in order
+std::vector<uint64_t> fix_sequences(const std::string& stream) {
+    std::vector<uint64_t> sequences;
+    for (size_t at = stream.find("\x01" "34="); at != std::string::npos; at = stream.find("\x01" "34=", at + 1)) {
+        sequences.push_back(std::stoull(stream.substr(at + 4)));
+    }
+    return sequences;
+}
+
+// Count of complete FIX messages (each ends with its checksum field)
+size_t fix_messages(const std::string& stream) {
+    size_t count = 0;
+    for (size_t at = stream.find("\x01" "10="); at != std::string::npos; at = stream.find("\x01" "10=", at + 1)) {
+        ++count;
+    }
+    return count;
+}
+
+std::string fix_message(const std::string& body) {
+    std::string message = "8=FIX.4.4\x01" "9=" + std::to_string(body.size()) + "\x01" + body;
+    unsigned checksum = 0;
+    for (char c : message) {
+        checksum += static_cast<unsigned char>(c);
+    }
+    char trailer[8];
+    std::snprintf(trailer, sizeof(trailer), "10=%03u\x01", checksum % 256);
+    return message + trailer;
+}
+
+void poll(OrderGateway& gateway) {
+    gateway.poll([](const ExecutionReport&) {});
+}
+
+}  // namespace
+
+TEST(binary_send_refused_as_full_keeps_its_sequence) {
+    LoopbackVenue venue;
+    OrderGateway gateway(config(venue, WireProtocol::Binary, 64));
+    gateway.connect();
+    CHECK(venue.accept());
+
+    CHECK(gateway.send(OrderRequestType::New, order(1)));
+    CHECK(!gateway.send(OrderRequestType::New, order(2)));  // 40 of 64 bytes taken
+    poll(gateway);
+    CHECK(gateway.send(OrderRequestType::Cancel, order(1)));
+    CHECK(gateway.send(OrderRequestType::New, order(2)));
+    poll(gateway);
+
+    std::string stream = venue.read(40 + 16 + 40);
+    CHECK(stream.size() == 40 + 16 + 40);
+    std::vector<uint32_t> sequences;
+    for (size_t at = 0; at + sizeof(entry_wire::MessageHeader) <= stream.size();) {
+        entry_wire::MessageHeader header;
+        std::memcpy(&header, stream.data() + at, sizeof(header));
+        sequences.push_back(header.sequence);
+        at += header.length;
+    }
+    CHECK(sequences == (std::vector<uint32_t>{1, 2, 3}));
+    CHECK(gateway.messages_sent() == 3);
+}
+
+TEST(fix_send_refused_as_full_leaves_no_seqnum_gap) {
+    LoopbackVenue venue;
+    OrderGateway gateway(config(venue, WireProtocol::Fix, 256));  // One order message at a time
+    gateway.connect();  // Logon, 34=1
+    CHECK(venue.accept());
+
+    CHECK(gateway.send(OrderRequestType::New, order(1)));
+    CHECK(!gateway.send(OrderRequestType::New, order(2)));
+    poll(gateway);
+    CHECK(gateway.send(OrderRequestType::New, order(2)));
+    poll(gateway);
+
+    std::string stream;
+    for (int i = 0; i < 100 && fix_messages(stream) < 3; ++i) {
+        stream += venue.read(1);
+    }
+    CHECK(fix_sequences(stream) == (std::vector<uint64_t>{1, 2, 3}));
+    CHECK(stream.find("\x01" "11=2\x01") != std::string::npos);
+}
+
+TEST(fix_test_request_is_answered_in_sequence) {
+    LoopbackVenue venue;
+    OrderGateway gateway(config(venue, WireProtocol::Fix, 4096));
+    gateway.connect();
+    CHECK(venue.accept());
+    CHECK(gateway.send(OrderRequestType::New, order(1)));
+    poll(gateway);
+    venue.write(fix_message("35=1\x01" "49=VENUE\x01" "56=LLSYS\x01" "34=2\x01" "112=PING\x01"));
+
+    std::string stream;
+    for (int i = 0; i < 100 && fix_messages(stream) < 3; ++i) {
+        poll(gateway);
+        stream += venue.read(1);
+    }
+    CHECK(fix_sequences(stream) == (std::vector<uint64_t>{1, 2, 3}));
+    size_t heartbeat = stream.find("35=0\x01");
+    CHECK(heartbeat != std::string::npos);
+    CHECK(heartbeat != std::string::npos && stream.find("112=PING\x01", heartbeat) != std::string::npos);
+}
+
+int main() {
+    return llsys_test::run_all();
+}
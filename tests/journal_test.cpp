@@ -0,0 +1,166 @@
+#include <sys/wait.h>
+#include <filesystem>
+#include "journal"
+#include "tests/test.hpp"
+
+// Order journal recovery. Entries are written straight through the journal's logger sink, and the
+// writer runs in a child that exits without close(), as a crash would leave the files.
+
+namespace {
+
+struct JournalFiles {
+    std::string path;
+
+    explicit JournalFiles(const char* name)
+        : path((std::filesystem::temp_directory_path() /
+                (std::string("llsys_") + name + "_" + std::to_string(::getpid()))).string()) {
+        remove();
+    }
+
+    ~JournalFiles() { remove(); }
+
+    void remove() const {
+        std::filesystem::remove(path);
+        std::filesystem::remove(path + ".snap");
+        std::filesystem::remove(path + ".snap.tmp");
+    }
+};
+
+template<typename... Args>
+void append(OrderJournal& journal, LogFormat format, const Args&... args) {
+    LogRecord record;
+    record.timestamp_ns = LatencyClock::now_ns();
+    record.format = format;
+    record.arg_count = 0;
+    (log_detail::encode(record, args), ...);
+    OrderJournal::write(&journal, record);
+}
+
+// Runs writer(journal) in a child that then exits without closing the journal
+template<typename Writer>
+bool crash_after(const OrderJournalConfig& config, Writer&& writer) {
+    pid_t pid = ::fork();
+    if (pid == 0) {
+        auto journal = new OrderJournal(config);  // Never closed or freed: the crash
+        writer(*journal);
+        ::_exit(0);
+    }
+    int status = 0;
+    return pid > 0 && ::waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// 20 entries: order 1 opened, amended and filled 10 x 5; order 2 opened, filled and closed
+void write_history(OrderJournal& journal, SymbolId symbol) {
+    LogSymbol s{symbol};
+    append(journal, LogFormat::JournalOrderOpened, uint64_t{1}, s, true, Price{1000}, size_t{100});
+    append(journal, LogFormat::JournalOrderAmended, uint64_t{1}, s, Price{1001}, size_t{80});
+    for (int i = 0; i < 10; ++i) {
+        append(journal, LogFormat::JournalFill, uint64_t{1}, s, true, Price{1001}, size_t{5});
+    }
+    append(journal, LogFormat::JournalOrderOpened, uint64_t{2}, s, false, Price{1010}, size_t{30});
+    for (int i = 0; i < 6; ++i) {
+        append(journal, LogFormat::JournalFill, uint64_t{2}, s, false, Price{1010}, size_t{5});
+    }
+    append(journal, LogFormat::JournalOrderClosed, uint64_t{2}, s);
+}
+
+}  // namespace
+
+TEST(recovers_snapshot_then_tail_after_crash) {
+    JournalFiles files("journal_tail");
+    SymbolId symbol = symbols().add("JRNL", 0.01);
+    OrderJournalConfig config{files.path, 64, 8};
+    CHECK(crash_after(config, [symbol](OrderJournal& journal) { write_history(journal, symbol); }));
+
+    OrderJournal journal(config);
+    const OrderLedger& ledger = journal.ledger();
+    CHECK(journal.sequence() == 20);
+    CHECK(journal.replayed() == 4);  // Snapshots at 8 and 16
+    CHECK(ledger.sequence() == 20);
+    CHECK(journal.position(symbol) == 50 - 30);
+    const OrderLedger::Position& position = ledger.position(symbol);
+    CHECK(position.fills == 16);
+    CHECK(position.last_order_id == 2);
+    CHECK(ledger.open_orders().size() == 1);
+    auto open = ledger.open_orders().find(1);
+    CHECK(open != ledger.open_orders().end());
+    if (open != ledger.open_orders().end()) {
+        CHECK(open->second.order.price == 1001);
+        CHECK(open->second.order.quantity == 80);
+        CHECK(open->second.filled == 50);
+    }
+}
+
+TEST(torn_tail_entry_ends_recovery) {
+    JournalFiles files("journal_torn");
+    SymbolId symbol = symbols().add("JRNL", 0.01);
+    OrderJournalConfig config{files.path, 64, 8};
+    CHECK(crash_after(config, [symbol](OrderJournal& journal) { write_history(journal, symbol); }));
+
+    // Tear the last entry (sequence 20, slot 19): it fails its checksum and is not replayed
+    int fd = ::open(files.path.c_str(), O_RDWR);
+    CHECK(fd >= 0);
+    off_t offset = static_cast<off_t>(tick_records_offset(MAX_SYMBOLS) + 19 * sizeof(OrderJournalEntry) +
+                                      offsetof(OrderJournalEntry, quantity));
+    uint64_t garbage = 12345;
+    CHECK(::pwrite(fd, &garbage, sizeof(garbage), offset) == static_cast<ssize_t>(sizeof(garbage)));
+    ::close(fd);
+
+    OrderJournal journal(config);
+    CHECK(journal.sequence() == 19);
+    CHECK(journal.replayed() == 3);
+    CHECK(journal.ledger().open_orders().size() == 2);  // The close of order 2 was torn
+    CHECK(journal.position(symbol) == 20);
+}
+
+TEST(clean_close_replays_nothing) {
+    JournalFiles files("journal_clean");
+    SymbolId symbol = symbols().add("JRNL", 0.01);
+    OrderJournalConfig config{files.path, 64, 8};
+    {
+        OrderJournal journal(config);
+        write_history(journal, symbol);
+    }
+    OrderJournal journal(config);
+    CHECK(journal.sequence() == 20);
+    CHECK(journal.replayed() == 0);
+    CHECK(journal.position(symbol) == 20);
+}
+
+TEST(ring_lapped_past_snapshot_is_refused) {
+    JournalFiles files("journal_lapped");
+    SymbolId symbol = symbols().add("JRNL", 0.01);
+    OrderJournalConfig config{files.path, 16, 8};
+    CHECK(crash_after(config, [symbol](OrderJournal& journal) { write_history(journal, symbol); }));
+    std::filesystem::remove(files.path + ".snap");  // Now entries 1-4 are gone and no snapshot covers them
+
+    bool refused = false;
+    try {
+        OrderJournal journal(config);
+    } catch (const std::runtime_error&) {
+        refused = true;
+    }
+    CHECK(refused);
+}
+
+TEST(closing_open_orders_at_startup_clears_them_for_good) {
+    JournalFiles files("journal_abandon");
+    SymbolId symbol = symbols().add("JRNL", 0.01);
+    OrderJournalConfig config{files.path, 64, 8};
+    CHECK(crash_after(config, [symbol](OrderJournal& journal) { write_history(journal, symbol); }));
+    {
+        OrderJournal journal(config);
+        CHECK(journal.ledger().open_orders().size() == 1);
+        CHECK(journal.close_open_orders() == 1);
+        CHECK(journal.ledger().open_orders().empty());
+        CHECK(journal.sequence() == 21);
+        CHECK(journal.position(symbol) == 20);  // Positions are untouched
+    }
+    OrderJournal journal(config);
+    CHECK(journal.ledger().open_orders().empty());
+    CHECK(journal.close_open_orders() == 0);
+}
+
+int main() {
+    return llsys_test::run_all();
+}
@@ -0,0 +1,574 @@
+#include <deque>
+#include <functional>
+#include <mutex>
+#include "journal"
+#include "mmcomp"
+#include "tests/test.hpp"
+
+// Order manager cancel / amend / replace handling against a scripted venue, and the market
+// maker's ladder diffing against a recording order manager. Reservations are tracked by a fake
+// risk policy, so every path can be checked for what it leaves reserved.
+
+namespace {
+
+SymbolId test_symbol() {
+    static SymbolId id = symbols().add("ORDR", 0.01);
+    return id;
+}
+
+// Reservation bookkeeping only: every check passes, fills consume what they fill
+struct FakeRisk {
+    std::atomic<int64_t> reserved{0};
+
+    bool check_order(const Order& order) {
+        reserved += static_cast<int64_t>(order.quantity);
+        return true;
+    }
+
+    uint64_t check_orders(std::span<const Order> orders) {
+        for (const Order& order : orders) {
+            reserved += static_cast<int64_t>(order.quantity);
+        }
+        return orders.size() == 64 ? ~uint64_t{0} : (uint64_t{1} << orders.size()) - 1;
+    }
+
+    void release(const Order&, size_t quantity) { reserved -= static_cast<int64_t>(quantity); }
+    void on_fill(const Order&, const Trade& fill) { reserved -= static_cast<int64_t>(fill.quantity); }
+    void reserve_overfill(const Order&, size_t quantity) { reserved += static_cast<int64_t>(quantity); }
+    int64_t position(SymbolId) const { return 0; }
+};
+
+struct Sent {
+    OrderRequestType type;
+    Order order;
+};
+
+// Venue stand-in driven by the order thread: records what is sent, refuses sends while full, and
+// hands scripted reports to poll()
+struct FakeGateway {
+    std::mutex mutex;
+    std::vector<Sent> sent;
+    std::deque<ExecutionReport> reports;
+    std::atomic<bool> full{false};
+
+    bool send(OrderRequestType type, const Order& order) {
+        if (full) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        sent.push_back(Sent{type, order});
+        return true;
+    }
+
+    template<typename Handler>
+    void poll(Handler&& handler) {
+        std::deque<ExecutionReport> ready;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ready.swap(reports);
+        }
+        for (const ExecutionReport& report : ready) {
+            handler(report);
+        }
+        if (ready.empty()) {
+            std::this_thread::yield();  // The order thread busy-polls; one core is shared with the test
+        }
+    }
+
+    void report(ExecutionReport::Kind kind, uint64_t order_id, size_t quantity = 0) {
+        ExecutionReport report;
+        report.kind = kind;
+        report.order_id = order_id;
+        report.last_quantity = quantity;
+        report.last_ticks = 100;
+        report.has_ticks = true;
+        std::lock_guard<std::mutex> lock(mutex);
+        reports.push_back(report);
+    }
+
+    size_t sent_count() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return sent.size();
+    }
+
+    Sent sent_at(size_t i) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return sent.at(i);
+    }
+};
+
+// Close, amend and fill notifications, from the order thread
+struct Notifications {
+    std::mutex mutex;
+    std::vector<Order> closed;
+    std::vector<Order> amended;
+    size_t fills = 0;
+
+    void on_order_closed(const Order& order) {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed.push_back(order);
+    }
+
+    void on_order_amended(const Order& order) {
+        std::lock_guard<std::mutex> lock(mutex);
+        amended.push_back(order);
+    }
+
+    void on_fill(const Trade&) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++fills;
+    }
+
+    size_t closed_count() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return closed.size();
+    }
+
+    size_t amended_count() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return amended.size();
+    }
+
+    Order amended_at(size_t i) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return amended.at(i);
+    }
+
+    size_t fill_count() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return fills;
+    }
+};
+
+template<typename Condition>
+bool eventually(Condition&& condition) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (std::chrono::steady_clock::now() < deadline) {
+        if (condition()) {
+            return true;
+        }
+        std::this_thread::yield();
+    }
+    return condition();
+}
+
+Order order(uint64_t order_id, Price price, size_t quantity) {
+    Order o;
+    o.order_id = order_id;
+    o.symbol = test_symbol();
+    o.is_buy = true;
+    o.price = price;
+    o.quantity = quantity;
+    o.timestamp = std::chrono::nanoseconds{0};
+    return o;
+}
+
+// An order manager on its own thread, attached to a FakeGateway
+struct Session {
+    FakeRisk risk;
+    FakeGateway gateway;
+    Notifications notes;
+    BasicOrderManager<FakeRisk> manager{risk};
+
+    Session() {
+        manager.attach_gateway(gateway);
+        manager.subscribe_closes(notes);
+        manager.subscribe_amends(notes);
+        manager.subscribe_fills(notes);
+        manager.start();
+    }
+
+    ~Session() { manager.stop(); }
+
+    // Submits the order and waits for it to reach the venue
+    bool open(const Order& o) {
+        size_t before = gateway.sent_count();
+        return manager.submit_order(o) == SubmitStatus::Accepted &&
+               eventually([&] { return gateway.sent_count() == before + 1; });
+    }
+
+    // Applies everything reported so far: a marker order's close is reported behind it
+    void drain() {
+        static uint64_t next_marker = uint64_t{1} << 60;
+        Order marker = order(next_marker++, 1, 1);
+        size_t closed = notes.closed_count();
+        CHECK(open(marker));
+        gateway.report(ExecutionReport::Kind::Cancelled, marker.order_id);
+        CHECK(eventually([&] { return notes.closed_count() == closed + 1; }));
+    }
+
+    // Queues a report and waits until its effect on the live table or reservations shows
+    template<typename Condition>
+    bool answer(ExecutionReport::Kind kind, uint64_t order_id, size_t quantity, Condition&& settled) {
+        gateway.report(kind, order_id, quantity);
+        return eventually(settled);
+    }
+};
+
+}  // namespace
+
+TEST(amend_increase_is_reserved_then_returned_when_refused) {
+    Session s;
+    CHECK(s.open(order(1, 50, 100)));
+    CHECK(s.risk.reserved == 100);
+
+    CHECK(s.manager.modify_order(1, 51, 150) == SubmitStatus::Accepted);
+    CHECK(eventually([&] { return s.gateway.sent_count() == 2; }));
+    Sent modify = s.gateway.sent_at(1);
+    CHECK(modify.type == OrderRequestType::Modify);
+    CHECK(modify.order.price == 51 && modify.order.quantity == 150);
+    CHECK(s.risk.reserved == 150);  // The increase is held while the venue decides
+
+    // A second amend while one is pending is dropped and reported with the order as it stands
+    CHECK(s.manager.modify_order(1, 52, 120) == SubmitStatus::Accepted);
+    CHECK(eventually([&] { return s.notes.amended_count() == 1; }));
+    CHECK(s.notes.amended_at(0).price == 50 && s.notes.amended_at(0).quantity == 100);
+    CHECK(s.gateway.sent_count() == 2);
+
+    CHECK(s.answer(ExecutionReport::Kind::CancelRejected, 1, 0, [&] { return s.notes.amended_count() == 2; }));
+    CHECK(s.notes.amended_at(1).price == 50 && s.notes.amended_at(1).quantity == 100);
+    CHECK(s.risk.reserved == 100);
+    CHECK(s.manager.live_orders() == 1);
+
+    // Still the acknowledged 100: a full fill of that retires it with nothing left reserved
+    CHECK(s.answer(ExecutionReport::Kind::Fill, 1, 100, [&] { return s.manager.live_orders() == 0; }));
+    CHECK(s.risk.reserved == 0);
+    CHECK(s.notes.closed_count() == 1);
+}
+
+TEST(amend_decrease_is_released_on_the_ack) {
+    Session s;
+    CHECK(s.open(order(1, 50, 100)));
+    CHECK(s.manager.modify_order(1, 49, 60) == SubmitStatus::Accepted);
+    CHECK(eventually([&] { return s.gateway.sent_count() == 2; }));
+    CHECK(s.risk.reserved == 100);  // Could still fill at 100 until the venue acks
+
+    CHECK(s.answer(ExecutionReport::Kind::Amended, 1, 0, [&] { return s.notes.amended_count() == 1; }));
+    CHECK(s.notes.amended_at(0).price == 49 && s.notes.amended_at(0).quantity == 60);
+    CHECK(s.risk.reserved == 60);
+
+    CHECK(s.answer(ExecutionReport::Kind::Fill, 1, 60, [&] { return s.manager.live_orders() == 0; }));
+    CHECK(s.risk.reserved == 0);
+}
+
+TEST(fill_racing_a_cancel_is_applied_before_the_close) {
+    Session s;
+    CHECK(s.open(order(1, 50, 100)));
+    CHECK(s.manager.cancel_order(1) == SubmitStatus::Accepted);
+    CHECK(eventually([&] { return s.gateway.sent_count() == 2; }));
+    CHECK(s.gateway.sent_at(1).type == OrderRequestType::Cancel);
+    CHECK(s.manager.cancel_order(1) == SubmitStatus::Accepted);  // Already pending: not resent
+    CHECK(s.manager.modify_order(1, 51, 100) == SubmitStatus::Accepted);  // Refused: cancel pending
+    CHECK(eventually([&] { return s.notes.amended_count() == 1; }));
+    CHECK(s.gateway.sent_count() == 2);
+    CHECK(s.manager.live_orders() == 1);  // Live until the venue reports
+
+    CHECK(s.answer(ExecutionReport::Kind::Fill, 1, 40, [&] { return s.notes.fill_count() == 1; }));
+    CHECK(s.risk.reserved == 60);
+    CHECK(s.manager.live_orders() == 1);
+
+    CHECK(s.answer(ExecutionReport::Kind::Cancelled, 1, 0, [&] { return s.manager.live_orders() == 0; }));
+    CHECK(s.risk.reserved == 0);
+    CHECK(s.notes.closed_count() == 1);
+
+    // A fill reported after the close matches nothing and reserves nothing
+    s.gateway.report(ExecutionReport::Kind::Fill, 1, 10);
+    s.drain();
+    CHECK(s.notes.fill_count() == 1);
+    CHECK(s.risk.reserved == 0);
+}
+
+TEST(refused_cancel_can_be_sent_again) {
+    Session s;
+    CHECK(s.open(order(1, 50, 100)));
+    CHECK(s.manager.cancel_order(1) == SubmitStatus::Accepted);
+    CHECK(eventually([&] { return s.gateway.sent_count() == 2; }));
+    s.gateway.report(ExecutionReport::Kind::CancelRejected, 1);
+    s.drain();
+    CHECK(s.manager.live_orders() == 1);
+    CHECK(s.manager.cancel_order(1) == SubmitStatus::Accepted);
+    CHECK(eventually([&] { return s.gateway.sent_count() == 4; }));  // The marker, then the cancel
+    CHECK(s.gateway.sent_at(3).type == OrderRequestType::Cancel);
+}
+
+TEST(gateway_full_closes_new_orders_and_keeps_live_ones) {
+    Session s;
+    s.gateway.full = true;
+    CHECK(s.manager.submit_order(order(1, 50, 100)) == SubmitStatus::Accepted);
+    CHECK(eventually([&] { return s.notes.closed_count() == 1; }));  // Never reached the venue
+    CHECK(s.risk.reserved == 0);
+    CHECK(s.manager.live_orders() == 0);
+
+    s.gateway.full = false;
+    CHECK(s.open(order(2, 50, 100)));
+    s.gateway.full = true;
+    CHECK(s.manager.cancel_order(2) == SubmitStatus::Accepted);
+    CHECK(s.manager.modify_order(2, 50, 130) == SubmitStatus::Accepted);
+    CHECK(eventually([&] { return s.notes.amended_count() == 1; }));  // Dropped, order as it stands
+    CHECK(s.notes.amended_at(0).quantity == 100);
+    CHECK(s.risk.reserved == 100);  // The increase was handed back; the order keeps its own
+    CHECK(s.manager.live_orders() == 1);
+
+    // The failed cancel left nothing pending, so a retry goes out
+    s.gateway.full = false;
+    CHECK(s.manager.cancel_order(2) == SubmitStatus::Accepted);
+    CHECK(eventually([&] { return s.gateway.sent_count() == 2; }));
+    CHECK(s.gateway.sent_at(1).type == OrderRequestType::Cancel);
+    CHECK(s.answer(ExecutionReport::Kind::Cancelled, 2, 0, [&] { return s.manager.live_orders() == 0; }));
+    CHECK(s.risk.reserved == 0);
+}
+
+TEST(full_request_queue_refuses_cancels_and_releases_submits) {
+    FakeRisk risk;
+    BasicOrderManager<FakeRisk> manager(risk);  // Never started: nothing drains the queue
+    size_t queued = 0;
+    while (manager.modify_order(1, 50, 100) == SubmitStatus::Accepted) {
+        ++queued;
+    }
+    CHECK(queued == manager.backlog());
+    CHECK(manager.cancel_order(1) == SubmitStatus::QueueFull);
+    CHECK(manager.submit_order(order(2, 50, 100)) == SubmitStatus::QueueFull);
+    CHECK(risk.reserved == 0);
+}
+
+TEST(restored_orders_hold_their_reservation_and_take_fills) {
+    FakeRisk risk;
+    FakeGateway gateway;
+    Notifications notes;
+    BasicOrderManager<FakeRisk> manager(risk);
+    manager.attach_gateway(gateway);
+    manager.subscribe_closes(notes);
+    manager.subscribe_fills(notes);
+
+    // As recovered from the journal: order 7 opened for 100, 30 filled before the restart
+    OrderLedger ledger;
+    OrderJournalEntry opened{};
+    opened.sequence = 1;
+    opened.order_id = 7;
+    opened.price = 50;
+    opened.quantity = 100;
+    opened.kind = OrderJournalEntry::OrderOpened;
+    opened.is_buy = 1;
+    ledger.apply(opened, test_symbol(), 0.01);
+    OrderJournalEntry fill = opened;
+    fill.sequence = 2;
+    fill.quantity = 30;
+    fill.kind = OrderJournalEntry::Fill;
+    ledger.apply(fill, test_symbol(), 0.01);
+
+    CHECK(ledger.restore_orders(manager) == 1);
+    CHECK(ledger.restore_orders(manager) == 0);  // Already live
+    CHECK(manager.live_orders() == 1);
+    CHECK(risk.reserved == 70);
+
+    manager.start();
+    gateway.report(ExecutionReport::Kind::Fill, 7, 70);
+    CHECK(eventually([&] { return manager.live_orders() == 0; }));
+    CHECK(notes.fill_count() == 1);
+    CHECK(notes.closed_count() == 1);
+    CHECK(risk.reserved == 0);
+    manager.stop();
+}
+
+// Market maker diffing
+
+namespace {
+
+// Records what the maker asks for; answers are delivered by the test through the maker's hooks
+struct FakeOrderManager {
+    using risk_policy = FakeRisk;
+
+    std::vector<OrderRequest> requests;  // Accepted only
+    bool queue_full = false;
+    size_t submit_calls = 0;
+
+    template<typename Listener>
+    void subscribe_closes(Listener&) {}
+    template<typename Listener>
+    void subscribe_amends(Listener&) {}
+
+    SubmitStatus cancel_order(uint64_t order_id) {
+        if (queue_full) {
+            return SubmitStatus::QueueFull;
+        }
+        OrderRequest request;
+        request.type = OrderRequestType::Cancel;
+        request.order.order_id = order_id;
+        requests.push_back(request);
+        return SubmitStatus::Accepted;
+    }
+
+    SubmitStatus modify_order(uint64_t order_id, Price price, size_t quantity) {
+        if (queue_full) {
+            return SubmitStatus::QueueFull;
+        }
+        OrderRequest request;
+        request.type = OrderRequestType::Modify;
+        request.order.order_id = order_id;
+        request.order.price = price;
+        request.order.quantity = quantity;
+        requests.push_back(request);
+        return SubmitStatus::Accepted;
+    }
+
+    BatchSubmitStatus submit_orders(std::span<const Order> orders) {
+        ++submit_calls;
+        if (queue_full) {
+            return BatchSubmitStatus{};
+        }
+        for (const Order& o : orders) {
+            requests.push_back(OrderRequest{OrderRequestType::New, 0, o});
+        }
+        return BatchSubmitStatus{(uint64_t{1} << orders.size()) - 1, 0};
+    }
+
+    // Requests of one type since the last take()
+    std::vector<Order> take(OrderRequestType type) {
+        std::vector<Order> matched;
+        std::vector<OrderRequest> rest;
+        for (const OrderRequest& request : requests) {
+            if (request.type == type) {
+                matched.push_back(request.order);
+            } else {
+                rest.push_back(request);
+            }
+        }
+        requests.swap(rest);
+        return matched;
+    }
+};
+
+using TestMaker = BasicMarketMaker<FakeOrderManager>;
+
+// Two levels a side around a 10000 mid: 9990 / 10010 for 100, then 9985 / 10015 for 50
+TestMaker::MarketMakingParams maker_params(size_t levels = 2) {
+    return TestMaker::MarketMakingParams{0.001, 100.0, 0.0, 1, levels, 0.5, true};
+}
+
+Quote maker_quote(Price mid) {
+    Quote q;
+    q.symbol = test_symbol();
+    q.bid = mid - 10;
+    q.ask = mid + 10;
+    return q;
+}
+
+struct MakerRig {
+    MarketDataHandler market_data;
+    FakeOrderManager orders;
+    FakeRisk risk;
+    TestMaker maker{market_data, orders, risk};
+
+    explicit MakerRig(size_t levels = 2) { maker.configure_symbol(test_symbol(), maker_params(levels)); }
+
+    void update(Price mid) { maker.update_quotes(test_symbol(), maker_quote(mid)); }
+};
+
+bool has_id(const std::vector<Order>& orders, uint64_t order_id) {
+    return std::any_of(orders.begin(), orders.end(), [order_id](const Order& o) { return o.order_id == order_id; });
+}
+
+}  // namespace
+
+TEST(maker_sends_the_ladder_once_and_diffs_after) {
+    MakerRig rig;
+    rig.update(10000);
+    std::vector<Order> placed = rig.orders.take(OrderRequestType::New);
+    CHECK(placed.size() == 4);
+    CHECK(rig.orders.submit_calls == 1);  // One batch for the whole ladder
+    CHECK(placed[0].price == 9990 && placed[0].quantity == 100 && placed[0].is_buy);
+    CHECK(placed[3].price == 10015 && placed[3].quantity == 50 && !placed[3].is_buy);
+
+    rig.update(10000);  // Unchanged ladder: nothing sent
+    CHECK(rig.orders.requests.empty());
+
+    rig.update(10005);  // Every level moves: amended in place under the same ids
+    std::vector<Order> amends = rig.orders.take(OrderRequestType::Modify);
+    CHECK(amends.size() == 4);
+    CHECK(amends[0].order_id == placed[0].order_id && amends[0].price == 9995);
+    CHECK(rig.orders.requests.empty());
+
+    rig.update(10010);  // Amends unanswered: nothing more for those levels
+    CHECK(rig.orders.requests.empty());
+}
+
+TEST(maker_requotes_a_refused_amend_and_a_closed_order) {
+    MakerRig rig;
+    rig.update(10000);
+    std::vector<Order> placed = rig.orders.take(OrderRequestType::New);
+    rig.update(10005);
+    std::vector<Order> amends = rig.orders.take(OrderRequestType::Modify);
+    CHECK(amends.size() == 4);
+
+    // Level 0 bid refused (still at 9990), the rest accepted; level 0 ask then fills away
+    rig.maker.on_order_amended(placed[0]);
+    for (size_t i = 1; i < amends.size(); ++i) {
+        Order accepted = placed[i];
+        accepted.price = amends[i].price;
+        rig.maker.on_order_amended(accepted);
+    }
+    rig.maker.on_order_closed(placed[2]);
+    rig.update(10005);
+    std::vector<Order> again = rig.orders.take(OrderRequestType::Modify);
+    CHECK(again.size() == 1);
+    CHECK(again.size() == 1 && again[0].order_id == placed[0].order_id && again[0].price == 9995);
+    std::vector<Order> replaced = rig.orders.take(OrderRequestType::New);
+    CHECK(replaced.size() == 1);
+    CHECK(replaced.size() == 1 && !replaced[0].is_buy && replaced[0].price == 10015 &&
+          replaced[0].order_id != placed[2].order_id);
+}
+
+TEST(maker_keeps_quotes_whose_cancel_found_the_queue_full) {
+    MakerRig rig;
+    rig.update(10000);
+    std::vector<Order> placed = rig.orders.take(OrderRequestType::New);
+    CHECK(placed.size() == 4);
+
+    // Reconfigured to one level while the order queue is full: nothing is forgotten or replaced
+    rig.maker.configure_symbol(test_symbol(), maker_params(1));
+    rig.orders.queue_full = true;
+    rig.update(10000);
+    rig.update(10000);
+    CHECK(rig.orders.requests.empty());
+    CHECK(rig.orders.submit_calls == 1);
+
+    // One of them closes meanwhile; the rest are cancelled once the queue drains, then requoted
+    rig.maker.on_order_closed(placed[1]);
+    rig.orders.queue_full = false;
+    rig.update(10000);
+    std::vector<Order> cancels = rig.orders.take(OrderRequestType::Cancel);
+    CHECK(cancels.size() == 3);
+    CHECK(has_id(cancels, placed[0].order_id) && has_id(cancels, placed[2].order_id) &&
+          has_id(cancels, placed[3].order_id));
+    CHECK(!has_id(cancels, placed[1].order_id));
+    std::vector<Order> requoted = rig.orders.take(OrderRequestType::New);
+    CHECK(requoted.size() == 2);
+
+    rig.update(10000);  // Retried once, not again
+    CHECK(rig.orders.requests.empty());
+}
+
+TEST(cancel_replace_mode_waits_for_each_queued_cancel) {
+    MarketDataHandler market_data;
+    FakeOrderManager orders;
+    FakeRisk risk;
+    TestMaker maker(market_data, orders, risk, QuoteUpdateMode::CancelReplace);
+    maker.configure_symbol(test_symbol(), maker_params());
+    maker.update_quotes(test_symbol(), maker_quote(10000));
+    std::vector<Order> placed = orders.take(OrderRequestType::New);
+    CHECK(placed.size() == 4);
+
+    orders.queue_full = true;
+    maker.update_quotes(test_symbol(), maker_quote(10000));
+    CHECK(orders.requests.empty());
+    size_t submits = orders.submit_calls;
+    orders.queue_full = false;
+    maker.update_quotes(test_symbol(), maker_quote(10000));
+    CHECK(orders.take(OrderRequestType::Cancel).size() == 4);
+    CHECK(orders.take(OrderRequestType::New).size() == 4);
+    CHECK(orders.submit_calls == submits + 1);
+}
+
+int main() {
+    return llsys_test::run_all();
+}
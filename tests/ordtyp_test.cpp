@@ -0,0 +1,374 @@
+#include "ordtyp.cpp"
+#include "tests/test.hpp"
+
+// TriggerEngine behaviour: what a quote fires, in what order, and what it never touches; trailing
+// cohorts, iceberg slices, OCO legs and bracket exits
+
+namespace {
+
+SymbolId test_symbol() {
+    static SymbolId id = symbols().add("TRIG", 0.01);
+    return id;
+}
+
+template<typename T>
+T make(uint64_t order_id, bool is_buy, size_t quantity = 100) {
+    T order{};
+    order.order_id = order_id;
+    order.symbol = test_symbol();
+    order.is_buy = is_buy;
+    order.quantity = quantity;
+    return order;
+}
+
+StopOrder stop(uint64_t order_id, bool is_buy, Price stop_price, size_t quantity = 100) {
+    StopOrder order = make<StopOrder>(order_id, is_buy, quantity);
+    order.stop_price = stop_price;
+    return order;
+}
+
+LimitOrder limit(uint64_t order_id, bool is_buy, Price limit_price, size_t quantity = 100) {
+    LimitOrder order = make<LimitOrder>(order_id, is_buy, quantity);
+    order.limit_price = limit_price;
+    return order;
+}
+
+StopLimitOrder stop_limit(uint64_t order_id, bool is_buy, Price stop_price, Price limit_price) {
+    StopLimitOrder order = make<StopLimitOrder>(order_id, is_buy);
+    order.stop_price = stop_price;
+    order.limit_price = limit_price;
+    return order;
+}
+
+TrailingStopOrder trailing(uint64_t order_id, bool is_buy, Price distance) {
+    TrailingStopOrder order = make<TrailingStopOrder>(order_id, is_buy);
+    order.trail_distance = distance;
+    return order;
+}
+
+Quote quote(Price bid, Price ask) {
+    Quote q;
+    q.symbol = test_symbol();
+    q.bid = bid;
+    q.ask = ask;
+    return q;
+}
+
+struct Emitted {
+    std::vector<Order> orders;
+
+    void operator()(const Order& order) { orders.push_back(order); }
+
+    std::vector<uint64_t> ids() const {
+        std::vector<uint64_t> result;
+        for (const Order& order : orders) {
+            result.push_back(order.order_id);
+        }
+        return result;
+    }
+};
+
+}  // namespace
+
+TEST(stop_fires_as_market_order_once_crossed) {
+    TriggerEngine engine(64);
+    CHECK(engine.add(stop(1, true, 105)));
+    CHECK(engine.add(stop(2, false, 95)));
+    Emitted emitted;
+
+    engine.on_quote(quote(96, 104), emitted);
+    CHECK(emitted.orders.empty());
+    engine.on_quote(quote(97, 105), emitted);  // Buy stop: ask reached 105
+    CHECK(emitted.ids() == (std::vector<uint64_t>{1}));
+    CHECK(emitted.orders[0].price == 0);
+    CHECK(emitted.orders[0].is_buy);
+    CHECK(emitted.orders[0].quantity == 100);
+    engine.on_quote(quote(94, 99), emitted);  // Sell stop: bid fell through 95
+    CHECK(emitted.ids() == (std::vector<uint64_t>{1, 2}));
+    CHECK(engine.pending() == 0);
+    engine.on_quote(quote(90, 110), emitted);  // Fired orders are gone
+    CHECK(emitted.orders.size() == 2);
+}
+
+TEST(equal_trigger_prices_fire_in_arrival_order) {
+    TriggerEngine engine(64);
+    CHECK(engine.add(stop(3, true, 105)));
+    CHECK(engine.add(stop(1, true, 104)));
+    CHECK(engine.add(stop(2, true, 105)));
+    Emitted emitted;
+    engine.on_quote(quote(100, 106), emitted);
+    CHECK(emitted.ids() == (std::vector<uint64_t>{1, 3, 2}));
+}
+
+TEST(stop_limit_rests_as_limit_after_its_stop) {
+    TriggerEngine engine(64);
+    CHECK(engine.add(stop_limit(1, false, 95, 96)));  // Sell: stop on bid <= 95, then limit bid >= 96
+    Emitted emitted;
+
+    engine.on_quote(quote(95, 97), emitted);  // Stop crossed, limit not reached
+    CHECK(emitted.orders.empty());
+    CHECK(engine.pending() == 1);
+    engine.on_quote(quote(94, 96), emitted);  // Resting as a limit: the stop does not fire again
+    CHECK(emitted.orders.empty());
+    engine.on_quote(quote(96, 98), emitted);
+    CHECK(emitted.ids() == (std::vector<uint64_t>{1}));
+    CHECK(emitted.orders[0].price == 96);
+    CHECK(!emitted.orders[0].is_buy);
+    CHECK(engine.pending() == 0);
+}
+
+TEST(stop_limit_checks_its_limit_on_the_crossing_quote) {
+    TriggerEngine engine(64);
+    CHECK(engine.add(stop_limit(1, true, 105, 106)));
+    Emitted emitted;
+    engine.on_quote(quote(103, 105), emitted);  // Stop crossed and ask 105 <= 106 already
+    CHECK(emitted.ids() == (std::vector<uint64_t>{1}));
+    CHECK(emitted.orders[0].price == 106);
+}
+
+TEST(stop_limit_never_reaches_limit_before_its_stop) {
+    TriggerEngine engine(64);
+    CHECK(engine.add(stop_limit(1, true, 105, 106)));
+    Emitted emitted;
+    engine.on_quote(quote(99, 100), emitted);  // Ask well under the limit, but the stop has not traded
+    CHECK(emitted.orders.empty());
+    CHECK(engine.pending() == 1);
+}
+
+TEST(uncrossed_orders_are_never_examined) {
+    constexpr uint64_t RESTING = 1000;
+    TriggerEngine engine(4 * RESTING + 8);
+    uint64_t id = 1;
+    for (uint64_t i = 0; i < RESTING; ++i) {
+        Price offset = static_cast<Price>(i);
+        CHECK(engine.add(stop(id++, true, 200 + offset)));
+        CHECK(engine.add(stop(id++, false, 50 - offset)));
+        CHECK(engine.add(limit(id++, true, 60 - offset)));
+        CHECK(engine.add(limit(id++, false, 190 + offset)));
+    }
+    uint64_t near = id++;
+    CHECK(engine.add(stop(near, true, 105)));
+    Emitted emitted;
+
+    for (int i = 0; i < 100; ++i) {
+        engine.on_quote(quote(99 - i % 3, 101 + i % 3), emitted);
+    }
+    CHECK(engine.examined() == 0);
+    CHECK(emitted.orders.empty());
+
+    engine.on_quote(quote(100, 105), emitted);
+    CHECK(engine.examined() == 1);
+    CHECK(emitted.ids() == (std::vector<uint64_t>{near}));
+    CHECK(engine.pending() == 4 * RESTING);
+
+    // A cancelled order is examined only when a quote reaches its price
+    CHECK(engine.cancel(1));
+    engine.on_quote(quote(100, 150), emitted);
+    CHECK(engine.examined() == 1);
+    engine.on_quote(quote(100, 200), emitted);  // Pops the cancelled stop at 200 and fires nothing
+    CHECK(engine.examined() == 2);
+    CHECK(emitted.orders.size() == 1);
+}
+
+TEST(trailing_stops_fire_by_cohort_from_their_own_peak) {
+    TriggerEngine engine(64);
+    Emitted emitted;
+    CHECK(engine.add(trailing(1, false, 5)));  // Before any quote: takes its peak from the first
+    engine.on_quote(quote(100, 101), emitted);
+    CHECK(engine.add(trailing(2, false, 5)));  // Joins 1 at peak 100
+    engine.on_quote(quote(98, 99), emitted);   // Below the extreme: no re-key
+    CHECK(engine.add(trailing(3, false, 5)));  // Its own cohort at peak 98
+
+    engine.on_quote(quote(96, 97), emitted);
+    CHECK(emitted.orders.empty());
+    engine.on_quote(quote(95, 96), emitted);  // 100 - 5: the older cohort fires whole, oldest first
+    CHECK(emitted.ids() == (std::vector<uint64_t>{1, 2}));
+    CHECK(emitted.orders[0].price == 0);
+    CHECK(engine.examined() == 2);
+    CHECK(engine.pending() == 1);
+    engine.on_quote(quote(93, 94), emitted);  // 98 - 5
+    CHECK(emitted.ids() == (std::vector<uint64_t>{1, 2, 3}));
+}
+
+TEST(new_extreme_merges_trailing_cohorts) {
+    TriggerEngine engine(64);
+    Emitted emitted;
+    engine.on_quote(quote(100, 101), emitted);
+    CHECK(engine.add(trailing(1, false, 5)));
+    engine.on_quote(quote(98, 99), emitted);
+    CHECK(engine.add(trailing(2, false, 5)));
+    engine.on_quote(quote(103, 104), emitted);  // Past both peaks: one cohort at 103
+
+    engine.on_quote(quote(99, 100), emitted);
+    CHECK(emitted.orders.empty());
+    engine.on_quote(quote(98, 99), emitted);
+    CHECK(emitted.ids() == (std::vector<uint64_t>{1, 2}));
+    CHECK(engine.pending() == 0);
+}
+
+TEST(buy_trailing_stop_follows_the_falling_ask) {
+    TriggerEngine engine(64);
+    Emitted emitted;
+    engine.on_quote(quote(99, 100), emitted);
+    CHECK(engine.add(trailing(1, true, 5)));
+    CHECK(engine.add(trailing(2, true, 8)));  // Another distance, another group
+    engine.on_quote(quote(89, 90), emitted);  // New low ask
+    engine.on_quote(quote(93, 94), emitted);
+    CHECK(emitted.orders.empty());
+    engine.on_quote(quote(94, 95), emitted);  // 90 + 5
+    CHECK(emitted.ids() == (std::vector<uint64_t>{1}));
+    CHECK(emitted.orders[0].is_buy);
+    engine.on_quote(quote(97, 98), emitted);  // 90 + 8
+    CHECK(emitted.ids() == (std::vector<uint64_t>{1, 2}));
+}
+
+TEST(cancelled_trailing_stop_never_fires) {
+    TriggerEngine engine(64);
+    Emitted emitted;
+    engine.on_quote(quote(100, 101), emitted);
+    CHECK(engine.add(trailing(1, false, 5)));
+    CHECK(engine.add(trailing(2, false, 5)));
+    CHECK(engine.cancel(1));
+    engine.on_quote(quote(95, 96), emitted);
+    CHECK(emitted.ids() == (std::vector<uint64_t>{2}));
+    CHECK(engine.pending() == 0);
+}
+
+TEST(iceberg_slices_take_child_ids_from_the_base) {
+    TriggerEngine engine(64, 1000);
+    IcebergOrder iceberg = make<IcebergOrder>(7, true, 250);
+    iceberg.limit_price = 50;
+    iceberg.display_quantity = 100;
+    Emitted emitted;
+
+    CHECK(engine.add(iceberg, emitted));
+    CHECK(emitted.ids() == (std::vector<uint64_t>{1000}));
+    CHECK(emitted.orders[0].quantity == 100);
+    CHECK(emitted.orders[0].price == 50);
+    CHECK(emitted.orders[0].is_buy);
+    CHECK(engine.pending() == 2);  // Parent and its working child
+
+    CHECK(engine.on_fill(1000, 60, emitted));  // Partial: the child keeps working
+    CHECK(emitted.orders.size() == 1);
+    CHECK(engine.on_fill(1000, 40, emitted));
+    CHECK(emitted.ids() == (std::vector<uint64_t>{1000, 1001}));
+    CHECK(emitted.orders[1].quantity == 100);
+    CHECK(engine.on_fill(1001, 100, emitted));  // The last slice is what is left
+    CHECK(emitted.ids() == (std::vector<uint64_t>{1000, 1001, 1002}));
+    CHECK(emitted.orders[2].quantity == 50);
+
+    CHECK(!engine.cancel(1002));  // Children are not cancelled through the engine
+    CHECK(engine.on_fill(1002, 50, emitted));
+    CHECK(emitted.orders.size() == 3);
+    CHECK(engine.pending() == 0);
+    CHECK(!engine.on_fill(1000, 1, emitted));  // Retired children are forgotten
+}
+
+TEST(iceberg_child_ids_never_repeat_across_orders) {
+    TriggerEngine engine(64, 1000);
+    Emitted emitted;
+    for (uint64_t id = 1; id <= 3; ++id) {
+        IcebergOrder iceberg = make<IcebergOrder>(id, false, 20);
+        iceberg.limit_price = 60;
+        iceberg.display_quantity = 10;
+        CHECK(engine.add(iceberg, emitted));
+    }
+    CHECK(engine.on_fill(1001, 10, emitted));  // Second iceberg's child, handle back in the pool
+    CHECK(engine.on_fill(1000, 10, emitted));
+    CHECK(emitted.ids() == (std::vector<uint64_t>{1000, 1001, 1002, 1003, 1004}));
+}
+
+TEST(oco_leg_firing_removes_its_sibling) {
+    TriggerEngine engine(64);
+    OcoOrder<LimitOrder, StopOrder> oco{limit(1, false, 110), stop(2, false, 90)};
+    CHECK(engine.add(oco));
+    Emitted emitted;
+    engine.on_quote(quote(111, 112), emitted);
+    CHECK(emitted.ids() == (std::vector<uint64_t>{1}));
+    CHECK(engine.pending() == 0);
+    engine.on_quote(quote(80, 81), emitted);  // The stop went with the limit
+    CHECK(emitted.orders.size() == 1);
+    CHECK(!engine.cancel(2));
+}
+
+TEST(oco_cancel_of_either_leg_cancels_both) {
+    TriggerEngine engine(64);
+    OcoOrder<LimitOrder, StopOrder> oco{limit(1, false, 110), stop(2, false, 90)};
+    CHECK(engine.add(oco));
+    CHECK(engine.cancel(2));
+    CHECK(engine.pending() == 0);
+    CHECK(!engine.cancel(1));
+    Emitted emitted;
+    engine.on_quote(quote(111, 112), emitted);
+    engine.on_quote(quote(80, 81), emitted);
+    CHECK(emitted.orders.empty());
+}
+
+TEST(oco_rejected_second_leg_leaves_nothing_behind) {
+    TriggerEngine engine(64);
+    CHECK(engine.add(stop(2, true, 120)));
+    OcoOrder<LimitOrder, StopOrder> oco{limit(1, false, 110), stop(2, false, 90)};  // Id 2 taken
+    CHECK(!engine.add(oco));
+    CHECK(engine.pending() == 1);
+    CHECK(engine.add(limit(1, false, 110)));  // The first leg's id was released
+}
+
+TEST(bracket_arms_exits_sized_to_fills_after_entry_fires) {
+    TriggerEngine engine(64, 500);
+    BracketOrder bracket{limit(1, true, 100), 110, 95};
+    CHECK(engine.add(bracket));
+    Emitted emitted;
+
+    CHECK(!engine.on_fill(1, 10, emitted));  // Not sent yet
+    engine.on_quote(quote(98, 101), emitted);
+    CHECK(emitted.orders.empty());
+    engine.on_quote(quote(99, 100), emitted);
+    CHECK(emitted.ids() == (std::vector<uint64_t>{1}));
+    CHECK(emitted.orders[0].price == 100);
+    engine.on_quote(quote(99, 100), emitted);  // Working: not emitted twice
+    CHECK(emitted.orders.size() == 1);
+    engine.on_quote(quote(111, 112), emitted);  // No exits before a fill
+    CHECK(emitted.orders.size() == 1);
+
+    CHECK(engine.on_fill(1, 40, emitted));
+    CHECK(engine.pending() == 3);  // Entry and both exits
+    CHECK(engine.on_fill(1, 60, emitted));  // Fully filled: the same pair grows, the entry retires
+    CHECK(engine.pending() == 2);
+    CHECK(!engine.on_fill(1, 1, emitted));
+
+    engine.on_quote(quote(110, 111), emitted);  // Take-profit: sell limit at 110
+    CHECK(emitted.ids() == (std::vector<uint64_t>{1, 500}));
+    CHECK(!emitted.orders[1].is_buy);
+    CHECK(emitted.orders[1].price == 110);
+    CHECK(emitted.orders[1].quantity == 100);
+    CHECK(engine.pending() == 0);
+    engine.on_quote(quote(90, 91), emitted);  // The stop-loss went with it
+    CHECK(emitted.orders.size() == 2);
+}
+
+TEST(bracket_rearms_after_an_exit_fires_between_fills) {
+    TriggerEngine engine(64, 500);
+    BracketOrder bracket{limit(1, false, 100), 90, 105};  // Sell entry: exits buy back
+    CHECK(engine.add(bracket));
+    Emitted emitted;
+    engine.on_quote(quote(100, 101), emitted);
+    CHECK(engine.on_fill(1, 30, emitted));
+
+    engine.on_quote(quote(104, 105), emitted);  // Stop-loss: buy stop on ask >= 105
+    CHECK(emitted.ids() == (std::vector<uint64_t>{1, 501}));
+    CHECK(emitted.orders[1].is_buy);
+    CHECK(emitted.orders[1].price == 0);
+    CHECK(emitted.orders[1].quantity == 30);
+    CHECK(engine.pending() == 1);  // Entry still working
+
+    CHECK(engine.on_fill(1, 70, emitted));  // A fresh pair for the new fills only
+    CHECK(engine.pending() == 2);
+    engine.on_quote(quote(89, 90), emitted);
+    CHECK(emitted.ids() == (std::vector<uint64_t>{1, 501, 502}));
+    CHECK(emitted.orders[2].quantity == 70);
+    CHECK(emitted.orders[2].price == 90);
+}
+
+int main() {
+    return llsys_test::run_all();
+}
@@ -0,0 +1,178 @@
+#include "common.hpp"
+#include "tests/test.hpp"
+
+// Ring buffers and the object pool under concurrent use. Counts are modest so the TSAN build
+// stays quick; interleavings come from the threads, not the volume.
+
+namespace {
+
+constexpr uint64_t ITEMS = 200000;
+
+}  // namespace
+
+TEST(spsc_preserves_order_across_batches) {
+    auto queue = std::make_unique<LockFreeQueue<uint64_t, 256>>();
+    std::thread producer([&]() {
+        uint64_t batch[7];
+        for (uint64_t next = 1; next <= ITEMS;) {
+            if (next % 3 == 0) {
+                size_t n = 0;
+                for (; n < 7 && next + n <= ITEMS; ++n) {
+                    batch[n] = next + n;
+                }
+                size_t pushed = queue->push_n(batch, n);
+                next += pushed;
+                if (pushed == 0) {
+                    std::this_thread::yield();  // Spinning starves the consumer on one core
+                }
+            } else if (queue->push(next)) {
+                ++next;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+    uint64_t expected = 1;
+    bool ordered = true;
+    uint64_t items[16];
+    while (expected <= ITEMS) {
+        size_t n = queue->pop_n(items, 16);
+        if (n == 0) {
+            std::this_thread::yield();
+        }
+        for (size_t i = 0; i < n; ++i) {
+            ordered &= items[i] == expected++;
+        }
+    }
+    producer.join();
+    CHECK(ordered);
+    CHECK(expected == ITEMS + 1);
+    CHECK(queue->size() == 0);
+}
+
+TEST(mpmc_delivers_every_item_once_in_producer_order) {
+    constexpr size_t PRODUCERS = 4;
+    constexpr size_t CONSUMERS = 4;
+    constexpr uint64_t PER_PRODUCER = ITEMS / PRODUCERS;
+    auto queue = std::make_unique<MpmcQueue<uint64_t, 1024>>();
+    std::atomic<uint64_t> consumed{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<bool> ordered{true};
+
+    std::vector<std::thread> threads;
+    for (size_t p = 0; p < PRODUCERS; ++p) {
+        threads.emplace_back([&, p]() {
+            uint64_t tag = uint64_t{p} << 32;
+            for (uint64_t seq = 1; seq <= PER_PRODUCER;) {
+                if (seq % 5 == 0 && seq + 1 <= PER_PRODUCER) {
+                    uint64_t pair[2] = {tag | seq, tag | (seq + 1)};
+                    if (queue->push_n(pair, 2)) {  // All or nothing
+                        seq += 2;
+                    } else {
+                        std::this_thread::yield();
+                    }
+                } else if (queue->push(tag | seq)) {
+                    ++seq;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (size_t c = 0; c < CONSUMERS; ++c) {
+        threads.emplace_back([&]() {
+            uint64_t last[PRODUCERS] = {};
+            uint64_t value = 0;
+            while (consumed.load(std::memory_order_relaxed) < PER_PRODUCER * PRODUCERS) {
+                if (!queue->pop(value)) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                uint64_t producer = value >> 32;
+                uint64_t seq = value & 0xFFFFFFFFu;
+                if (producer >= PRODUCERS || seq <= last[producer]) {
+                    ordered = false;
+                } else {
+                    last[producer] = seq;
+                }
+                sum.fetch_add(seq, std::memory_order_relaxed);
+                consumed.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    CHECK(ordered.load());
+    CHECK(consumed.load() == PER_PRODUCER * PRODUCERS);
+    CHECK(sum.load() == PRODUCERS * PER_PRODUCER * (PER_PRODUCER + 1) / 2);
+    CHECK(queue->size() == 0);
+}
+
+TEST(allocator_never_hands_out_a_slot_twice) {
+    constexpr size_t THREADS = 4;
+    constexpr size_t CAPACITY = 64;
+    constexpr size_t ROUNDS = 50000;
+    struct Tagged {
+        uint64_t owner;
+        uint64_t round;
+    };
+    LockFreeAllocator<Tagged> pool(CAPACITY);
+    std::atomic<bool> clean{true};
+    std::atomic<uint64_t> misses{0};
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < THREADS; ++t) {
+        threads.emplace_back([&, t]() {
+            Tagged* held[CAPACITY / THREADS * 2] = {};
+            for (size_t round = 0; round < ROUNDS; ++round) {
+                Tagged*& slot = held[round % std::size(held)];
+                if (slot) {
+                    if (slot->owner != t || !pool.owns(slot)) {
+                        clean = false;
+                    }
+                    pool.destroy(slot);
+                    slot = nullptr;
+                }
+                slot = pool.create(Tagged{t, round});
+                if (!slot) {
+                    misses.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+            for (Tagged* slot : held) {
+                if (slot) {
+                    clean = clean && slot->owner == t;
+                    pool.destroy(slot);
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    CHECK(clean.load());
+    CHECK(pool.in_use() == 0);
+    CHECK(pool.high_water_mark() <= CAPACITY);
+    CHECK(pool.exhausted_count() == misses.load());
+}
+
+TEST(allocator_exhaustion_returns_null_and_counts) {
+    LockFreeAllocator<uint64_t> pool(4);
+    uint64_t* slots[4];
+    for (auto& slot : slots) {
+        slot = pool.create(uint64_t{7});
+        CHECK(slot != nullptr);
+    }
+    CHECK(pool.allocate() == nullptr);
+    CHECK(pool.exhausted_count() == 1);
+    pool.destroy(slots[2]);
+    uint64_t* again = pool.allocate();
+    CHECK(again == slots[2]);  // LIFO free list
+    CHECK(pool.index_of(again) == 2);
+    CHECK(pool.in_use() == 4);
+    CHECK(pool.high_water_mark() == 4);
+}
+
+int main() {
+    return llsys_test::run_all();
+}
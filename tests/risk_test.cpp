@@ -0,0 +1,71 @@
+#include "riskmgmt"
+#include "tests/test.hpp"
+
+// Pre-trade reservations in AdvancedRiskManager, as seen through check_order
+
+namespace {
+
+AdvancedRiskManager::RiskLimits limits(double max_net_position) {
+    AdvancedRiskManager::RiskLimits l{};
+    l.max_gross_position = 1e9;
+    l.max_net_position = max_net_position;
+    l.max_dollar_exposure = 1e12;
+    l.var_limit = 1e12;
+    l.es_limit = 1e12;
+    l.max_drawdown_limit = 1e12;
+    l.max_position_duration = std::chrono::hours(24);
+    l.max_order_size = 1000;
+    l.max_daily_loss = 1e12;
+    l.max_daily_trades = 1000000;
+    return l;
+}
+
+Order buy(SymbolId symbol, uint64_t order_id, size_t quantity) {
+    Order order;
+    order.order_id = order_id;
+    order.symbol = symbol;
+    order.is_buy = true;
+    order.price = 10000;
+    order.quantity = quantity;
+    return order;
+}
+
+Trade bought(SymbolId symbol, size_t quantity) {
+    Trade trade;
+    trade.symbol = symbol;
+    trade.price = 10000;
+    trade.quantity = quantity;
+    trade.is_buy = true;
+    return trade;
+}
+
+}  // namespace
+
+TEST(own_fills_consume_their_reservation) {
+    SymbolId symbol = symbols().add("RISKA", 0.01);
+    AdvancedRiskManager risk;
+    risk.set_risk_limits(symbol, limits(100));
+    Order order = buy(symbol, 1, 50);
+    CHECK(risk.check_order(order));
+    risk.on_fill(order, bought(symbol, 50));
+    CHECK(risk.position(symbol) == 50);
+    CHECK(risk.check_order(buy(symbol, 2, 50)));   // 50 held + 50 open
+    CHECK(!risk.check_order(buy(symbol, 3, 1)));
+}
+
+TEST(subscribed_fills_move_position_without_releasing) {
+    SymbolId symbol = symbols().add("RISKB", 0.01);
+    AdvancedRiskManager risk;
+    risk.set_risk_limits(symbol, limits(100));
+    risk.on_fill(bought(symbol, 50));  // Another policy's order: nothing of ours to release
+    risk.on_fill(bought(symbol, 20));
+    CHECK(risk.position(symbol) == 70);
+    CHECK(risk.check_order(buy(symbol, 1, 30)));
+    CHECK(!risk.check_order(buy(symbol, 2, 1)));  // Worst case 70 + 30 + 1
+    risk.release(buy(symbol, 1, 30), 30);
+    CHECK(risk.check_order(buy(symbol, 3, 30)));
+}
+
+int main() {
+    return llsys_test::run_all();
+}
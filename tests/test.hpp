@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdio>
+#include <exception>
+#include <vector>
+
+// Minimal test harness
+// TEST(name) registers a case with its binary; main() returns llsys_test::run_all(), which runs
+// every case and fails if any CHECK did. One binary per area, registered with ctest, so the
+// sanitizer builds run the same cases.
+namespace llsys_test {
+
+struct Case {
+    const char* name;
+    void (*fn)();
+};
+
+inline std::vector<Case>& cases() {
+    static std::vector<Case> all;
+    return all;
+}
+
+inline int& failures() {
+    static int count = 0;
+    return count;
+}
+
+struct Register {
+    Register(const char* name, void (*fn)()) { cases().push_back(Case{name, fn}); }
+};
+
+inline int run_all() {
+    for (const Case& c : cases()) {
+        int before = failures();
+        try {
+            c.fn();
+        } catch (const std::exception& e) {
+            std::fprintf(stderr, "%s: threw %s\n", c.name, e.what());
+            ++failures();
+        }
+        std::printf("%-56s %s\n", c.name, failures() == before ? "ok" : "FAILED");
+    }
+    return failures() == 0 ? 0 : 1;
+}
+
+}  // namespace llsys_test
+
+#define TEST(name)                                                      \
+    static void name();                                                 \
+    static const llsys_test::Register name##_registered(#name, name);  \
+    static void name()
+
+#define CHECK(condition)                                                                        \
+    do {                                                                                        \
+        if (!(condition)) {                                                                     \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition);  \
+            ++llsys_test::failures();                                                           \
+        }                                                                                       \
+    } while (0)